@@ -0,0 +1,60 @@
+#include "MappedFile.h"
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+bool MappedFile::open( const std::string& filename )
+{
+   close();
+#ifdef _WIN32
+   HANDLE file = ::CreateFileA( filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr );
+   if ( file == INVALID_HANDLE_VALUE )
+      return false;
+   LARGE_INTEGER size;
+   HANDLE mapping = ::GetFileSizeEx( file, &size ) && size.QuadPart > 0 ? ::CreateFileMappingA( file, nullptr, PAGE_READONLY, 0, 0, nullptr ) : nullptr;
+   void* data = mapping ? ::MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 ) : nullptr;
+   if ( !data )
+   {
+      if ( mapping )
+         ::CloseHandle( mapping );
+      ::CloseHandle( file );
+      return false;
+   }
+   _File = file;
+   _Mapping = mapping;
+   _Size = (size_t) size.QuadPart;
+#else
+   int fd = ::open( filename.c_str(), O_RDONLY );
+   if ( fd < 0 )
+      return false;
+   struct stat st;
+   void* data = ::fstat( fd, &st ) == 0 && st.st_size > 0 ? ::mmap( nullptr, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 ) : MAP_FAILED;
+   ::close( fd ); // (the mapping stays)
+   if ( data == MAP_FAILED )
+      return false;
+   _Size = (size_t) st.st_size;
+#endif
+   _Data = (const uint8_t*) data;
+   return true;
+}
+
+void MappedFile::close()
+{
+   if ( !_Data )
+      return;
+#ifdef _WIN32
+   ::UnmapViewOfFile( _Data );
+   ::CloseHandle( _Mapping );
+   ::CloseHandle( _File );
+   _File = _Mapping = nullptr;
+#else
+   ::munmap( (void*) _Data, _Size );
+#endif
+   _Data = nullptr;
+   _Size = 0;
+}
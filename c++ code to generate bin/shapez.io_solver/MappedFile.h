@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// a file mapped read-only into memory, so its bytes are read in place instead of copied
+class MappedFile
+{
+public:
+   MappedFile() {}
+   MappedFile( const std::string& filename ) { open( filename ); }
+   ~MappedFile() { close(); }
+   MappedFile( const MappedFile& ) = delete;
+   MappedFile& operator=( const MappedFile& ) = delete;
+
+   bool open( const std::string& filename ); // false if it can't be mapped (empty files can't)
+   void close();
+
+public:
+   const uint8_t* _Data = nullptr;
+   size_t _Size = 0;
+#ifdef _WIN32
+   void* _File = nullptr;
+   void* _Mapping = nullptr;
+#endif
+};
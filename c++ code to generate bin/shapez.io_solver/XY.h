@@ -50,7 +50,7 @@ public:
    void operator=( const XY& rhs )     { p = rhs; }
    XY    next() const                  { return p.x+1 >= size.x ? XY( 0, p.y+1 ) : XY( p.x+1, p.y ); }
    XYit& operator++()                  { if ( ++p.x >= size.x ) { p.x = 0; ++p.y; } return *this; }
-   XYit& operator++( int n )           { return ++*this; }
+   XYit& operator++( int )             { return ++*this; }
    
    bool operator==( const XY& q ) const{ return p == q; }
    bool operator!=( const XY& q ) const{ return p != q; }
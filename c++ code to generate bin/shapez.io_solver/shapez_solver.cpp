@@ -0,0 +1,209 @@
+#include "shapez_solver.h"
+#include "solver.h"
+
+#include <memory>
+#include <mutex>
+
+struct shapez_recipes
+{
+   Recipes recipes;
+};
+
+namespace
+{
+   // "--" or a shape letter and a color letter per quadrant, 4 quadrants per layer, 1 to 4 layers
+   bool isShapeCode( const char* code )
+   {
+      size_t length = strlen( code );
+      if ( length == 0 || length > SHAPEZ_MAX_CODE_LENGTH - 1 || (length + 1) % 9 != 0 )
+         return false;
+      for ( size_t i = 0; i < length; i++ )
+      {
+         if ( i % 9 == 8 )
+         {
+            if ( code[i] != ':' ) return false;
+            continue;
+         }
+         if ( i % 2 == (i / 9) % 2 ) // first letter of a quadrant
+         {
+            char c0 = code[i], c1 = code[i+1];
+            if ( !(c0 == '-' && c1 == '-') && !(c0 >= 'A' && c0 <= 'Z' && c1 >= 'a' && c1 <= 'z') )
+               return false;
+         }
+      }
+      return shapeFromCode( code ).code() != 0;
+   }
+
+   int32_t treeCost( const Recipes& recipes, uint16_t code, int rotateCost, int cutCost, int stackCost )
+   {
+      const Recipe& recipe = recipes[code];
+      int32_t ret = opCost( recipe.op, rotateCost, cutCost, stackCost );
+      if ( recipe.op != RAW ) ret += treeCost( recipes, recipe.a, rotateCost, cutCost, stackCost );
+      if ( recipe.op == STACK ) ret += treeCost( recipes, recipe.b, rotateCost, cutCost, stackCost );
+      return ret;
+   }
+
+   std::mutex generateMutex; // the generator traces its progress through std::trace, one ostream that two threads
+                             // must not write to at once (only its line buffer is per thread)
+}
+
+extern "C" {
+
+SHAPEZ_API uint32_t shapez_abi_version( void )
+{
+   return SHAPEZ_ABI_VERSION;
+}
+
+SHAPEZ_API void shapez_set_trace_callback( shapez_trace_callback callback, void* context )
+{
+   setTraceCallback( callback, context );
+}
+
+SHAPEZ_API int shapez_recipes_load( const char* filename, shapez_recipes** recipes )
+{
+   if ( !recipes ) return SHAPEZ_ERROR_ARGUMENT;
+   *recipes = nullptr;
+   if ( !filename ) return SHAPEZ_ERROR_ARGUMENT;
+   try
+   {
+      std::unique_ptr<shapez_recipes> ret( new shapez_recipes );
+      if ( !ret->recipes.loadFromFile( filename ) )
+         return SHAPEZ_ERROR_FILE;
+      *recipes = ret.release();
+      return SHAPEZ_OK;
+   }
+   catch ( ... )
+   {
+      return SHAPEZ_ERROR_INTERNAL;
+   }
+}
+
+SHAPEZ_API int shapez_recipes_from_memory( const void* data, size_t size, shapez_recipes** recipes )
+{
+   if ( !recipes ) return SHAPEZ_ERROR_ARGUMENT;
+   *recipes = nullptr;
+   try
+   {
+      std::unique_ptr<shapez_recipes> ret( new shapez_recipes );
+      if ( !data || size != ret->recipes._Recipes.size() * sizeof(Recipe) )
+         return SHAPEZ_ERROR_ARGUMENT;
+      memcpy( ret->recipes._Recipes.data(), data, size );
+      if ( !ret->recipes.isValid() )
+         return SHAPEZ_ERROR_ARGUMENT;
+      ret->recipes.indexUsers();
+      *recipes = ret.release();
+      return SHAPEZ_OK;
+   }
+   catch ( ... )
+   {
+      return SHAPEZ_ERROR_INTERNAL;
+   }
+}
+
+SHAPEZ_API int shapez_generate( int rotate_cost, int cut_cost, int stack_cost, uint32_t op_mask, shapez_recipes** recipes )
+{
+   if ( !recipes ) return SHAPEZ_ERROR_ARGUMENT;
+   *recipes = nullptr;
+   if ( rotate_cost < 0 || cut_cost < 0 || stack_cost < 1 ) return SHAPEZ_ERROR_ARGUMENT;
+   try
+   {
+      std::unique_ptr<shapez_recipes> ret( new shapez_recipes );
+      {
+         std::lock_guard<std::mutex> lock( generateMutex );
+         ret->recipes = generateRecipes( rotate_cost, cut_cost, stack_cost, false, op_mask );
+      }
+      *recipes = ret.release();
+      return SHAPEZ_OK;
+   }
+   catch ( ... )
+   {
+      return SHAPEZ_ERROR_INTERNAL;
+   }
+}
+
+SHAPEZ_API void shapez_recipes_free( shapez_recipes* recipes )
+{
+   delete recipes;
+}
+
+SHAPEZ_API int shapez_parse_codes( const char* const* codes, size_t n, uint16_t* shapes, int32_t* statuses )
+{
+   if ( n && (!codes || !shapes || !statuses) ) return SHAPEZ_ERROR_ARGUMENT;
+   int ret = SHAPEZ_OK;
+   for ( size_t i = 0; i < n; i++ )
+   {
+      bool ok = codes[i] && isShapeCode( codes[i] );
+      shapes[i] = ok ? shapeFromCode( codes[i] ).code() : 0;
+      statuses[i] = ok ? SHAPEZ_OK : SHAPEZ_ERROR_SHAPE_CODE;
+      if ( !ok ) ret = SHAPEZ_ERROR_SHAPE_CODE;
+   }
+   return ret;
+}
+
+SHAPEZ_API int shapez_format_shape( uint16_t shape, char* code, size_t code_size )
+{
+   if ( !code ) return SHAPEZ_ERROR_ARGUMENT;
+   std::string str = Shape::fromCode( shape ).str();
+   if ( str.size() + 1 > code_size ) return SHAPEZ_ERROR_BUFFER_TOO_SMALL;
+   memcpy( code, str.c_str(), str.size() + 1 );
+   return SHAPEZ_OK;
+}
+
+SHAPEZ_API int shapez_lookup( const shapez_recipes* recipes, const uint16_t* shapes, size_t n, int rotate_cost, int cut_cost, int stack_cost,
+                              uint32_t op_mask, shapez_recipe* recipes_out, int32_t* costs )
+{
+   if ( !recipes || (n && (!shapes || !recipes_out || !costs)) ) return SHAPEZ_ERROR_ARGUMENT;
+   try
+   {
+      int ret = SHAPEZ_OK;
+      for ( size_t i = 0; i < n; i++ )
+      {
+         const Recipe& recipe = recipes->recipes[shapes[i]];
+         bool possible = recipes->recipes.isPossible( shapes[i], op_mask );
+         recipes_out[i].a = possible ? recipe.a : 0;
+         recipes_out[i].b = possible ? recipe.b : 0;
+         recipes_out[i].op = (uint8_t) (possible ? recipe.op : NONE);
+         costs[i] = possible ? treeCost( recipes->recipes, shapes[i], rotate_cost, cut_cost, stack_cost ) : SHAPEZ_IMPOSSIBLE_COST;
+         if ( !possible ) ret = SHAPEZ_ERROR_IMPOSSIBLE;
+      }
+      return ret;
+   }
+   catch ( ... )
+   {
+      return SHAPEZ_ERROR_INTERNAL;
+   }
+}
+
+SHAPEZ_API int shapez_solve( const shapez_recipes* recipes, const char* const* targets, size_t n, uint32_t op_mask,
+                             char* buffer, size_t buffer_size, size_t* offsets, int32_t* statuses, size_t* required_size )
+{
+   if ( !recipes || !required_size || (n && (!targets || !offsets || !statuses)) || (buffer_size && !buffer) ) return SHAPEZ_ERROR_ARGUMENT;
+   try
+   {
+      size_t size = 0;
+      for ( size_t i = 0; i < n; i++ )
+      {
+         std::string json;
+         statuses[i] = SHAPEZ_OK;
+         if ( !targets[i] || !isShapeCode( targets[i] ) )
+            statuses[i] = SHAPEZ_ERROR_SHAPE_CODE;
+         else if ( !recipes->recipes.isPossible( shapeFromCode( targets[i] ).code(), op_mask ) )
+            statuses[i] = SHAPEZ_ERROR_IMPOSSIBLE;
+         else
+            json = recipes->recipes.bluePrintFor( targets[i], op_mask ).toJson();
+
+         offsets[i] = size;
+         if ( size + json.size() + 1 <= buffer_size )
+            memcpy( buffer + size, json.c_str(), json.size() + 1 );
+         size += json.size() + 1;
+      }
+      *required_size = size;
+      return size <= buffer_size ? SHAPEZ_OK : SHAPEZ_ERROR_BUFFER_TOO_SMALL;
+   }
+   catch ( ... )
+   {
+      return SHAPEZ_ERROR_INTERNAL;
+   }
+}
+
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+// C interface of the solver (built as shapez.io_solver_lib), for calling it in-process from other languages.
+//
+// Shapes are passed as codes like "CuCu----:--Cr--Cr" or as the 16 bit shape numbers of the recipe tables
+// (bit 4*layer + quadrant, quadrants in the order top right, bottom right, bottom left, top left).
+//
+// Thread safety: a loaded shapez_recipes is never modified, so any number of threads may use the same handle at
+// once; only shapez_recipes_free must not overlap with other calls on that handle. shapez_generate may be called
+// from any thread, concurrent calls run one after the other. No function keeps pointers the caller passed in.
+//
+// Batch functions fill caller-provided arrays of n entries and never allocate memory that the caller must free.
+// Functions return SHAPEZ_OK or an error status; batch functions also give a status per entry.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef _WIN32
+#ifdef SHAPEZ_SOLVER_EXPORTS
+#define SHAPEZ_API __declspec(dllexport)
+#else
+#define SHAPEZ_API __declspec(dllimport)
+#endif
+#else
+#define SHAPEZ_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SHAPEZ_ABI_VERSION 1
+#define SHAPEZ_MAX_CODE_LENGTH 36 // "xxxxxxxx:xxxxxxxx:xxxxxxxx:xxxxxxxx" and the terminating 0
+#define SHAPEZ_IMPOSSIBLE_COST -1
+#define SHAPEZ_ALL_OPS 0xFFFFFFFFu // an op_mask that takes every op
+
+enum shapez_status
+{
+   SHAPEZ_OK = 0,
+   SHAPEZ_ERROR_ARGUMENT = 1,         // a null pointer, a size that can't be right or a table that isn't one
+   SHAPEZ_ERROR_FILE = 2,             // the recipe file is missing, too short or not a recipe table
+   SHAPEZ_ERROR_SHAPE_CODE = 3,       // not a shape code
+   SHAPEZ_ERROR_IMPOSSIBLE = 4,       // the table has no recipe for the shape (with the ops of op_mask)
+   SHAPEZ_ERROR_BUFFER_TOO_SMALL = 5, // see the required size
+   SHAPEZ_ERROR_INTERNAL = 6
+};
+
+// a loaded recipe table (see Recipes)
+typedef struct shapez_recipes shapez_recipes;
+
+typedef struct shapez_recipe
+{
+   uint16_t a;  // input shape (the bottom one for a stack)
+   uint16_t b;  // top shape of a stack, else 0
+   uint8_t op;  // the solver's Op: 1 raw, 2 stack, 3/4 cut left/right, 5-7 rotate 1-3, 8-11 quad cut TR/BR/BL/TL
+} shapez_recipe;
+
+SHAPEZ_API uint32_t shapez_abi_version( void );
+
+// The library prints nothing; to see its trace lines (progress of shapez_generate, why a file didn't load) pass a
+// callback, which gets each line with its '\n' and may be called from any thread. Set it before other calls;
+// 0 turns tracing off again.
+typedef void (*shapez_trace_callback)( const char* line, void* context );
+SHAPEZ_API void shapez_set_trace_callback( shapez_trace_callback callback, void* context );
+
+// handles; *recipes is set to 0 on failure. Loaded tables are checked first (known ops, possible inputs, no recipe
+// tree containing itself), so the other functions can follow their recipes.
+SHAPEZ_API int shapez_recipes_load( const char* filename, shapez_recipes** recipes );
+SHAPEZ_API int shapez_recipes_from_memory( const void* data, size_t size, shapez_recipes** recipes ); // the contents of a recipe file
+SHAPEZ_API int shapez_generate( int rotate_cost, int cut_cost, int stack_cost, uint32_t op_mask, shapez_recipes** recipes ); // op_mask: bit 1 << op
+SHAPEZ_API void shapez_recipes_free( shapez_recipes* recipes );
+
+// The queries take the ops the factory may use as op_mask, bit 1 << op. A table has one recipe per shape, so a shape
+// whose recipe tree needs another op is SHAPEZ_ERROR_IMPOSSIBLE; shapez_generate with that op_mask gives the best
+// recipes without it.
+
+// shape model: codes <=> shape numbers (colors are dropped), and whether the table can make them
+SHAPEZ_API int shapez_parse_codes( const char* const* codes, size_t n, uint16_t* shapes, int32_t* statuses );
+SHAPEZ_API int shapez_format_shape( uint16_t shape, char* code, size_t code_size );
+SHAPEZ_API int shapez_lookup( const shapez_recipes* recipes, const uint16_t* shapes, size_t n, int rotate_cost, int cut_cost, int stack_cost,
+                              uint32_t op_mask, shapez_recipe* recipes_out, int32_t* costs );
+
+// Blueprint JSON (as the game imports it) for each target, written one after the other into `buffer`, each ending
+// in 0 and starting at offsets[i]. If they don't fit, returns SHAPEZ_ERROR_BUFFER_TOO_SMALL with *required_size set
+// and nothing usable in `buffer`. Targets that fail get their status and an empty string.
+SHAPEZ_API int shapez_solve( const shapez_recipes* recipes, const char* const* targets, size_t n, uint32_t op_mask,
+                             char* buffer, size_t buffer_size, size_t* offsets, int32_t* statuses, size_t* required_size );
+
+#ifdef __cplusplus
+}
+#endif
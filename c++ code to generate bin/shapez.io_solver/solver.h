@@ -0,0 +1,4278 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <sstream>
+#include <fstream>
+#include <unordered_set>
+#include <set>
+#include <deque>
+#include <bitset>
+#include <functional>
+#include <thread>
+#include <atomic>
+#include <unordered_map>
+#include <cstring>
+#include <map>
+#include <tuple>
+#include <cmath>
+
+#include "XY.h"
+#include "trace.h"
+#include "MappedFile.h"
+
+
+
+class Layer
+{
+public:
+   Layer( uint8_t b=0 ) : b(b) {}
+   bool isEmpty() const { return b == 0; }
+   Layer rotated() const { return ((b<<1)&15) | ((b&8) ? 1 : 0); }
+   Layer flipped() const { return (b&5) | ((b&8) ? 2 : 0) | ((b&2) ? 8 : 0); }
+   std::string str() const { std::string s; for ( int i = 0; i < 4; i++ ) s += b & (1<<i) ? "Cu" : "--"; return s; }
+   Layer cutRight() const { return b & 3; }
+   Layer cutLeft() const { return b & 12; }
+   bool intersects( const Layer& rhs ) const { return b & rhs.b; }
+
+public:
+   uint8_t b;
+};
+
+class Shape
+{
+public:
+   int numLayers() const { for ( int i = 3; i >= 0; i-- ) if ( !layers[i].isEmpty() ) return i+1; return 0; }
+   std::string str() const { std::string s; for ( int i = 0; i < numLayers(); i++ ) { if (i) s += ":"; s += layers[i].str(); } return s; }
+   Shape rotated() const { Shape ret; for ( int i = 0; i < 4; i++ ) ret.layers[i] = layers[i].rotated(); return ret; }
+   Shape flipped() const { Shape ret; for ( int i = 0; i < 4; i++ ) ret.layers[i] = layers[i].flipped(); return ret; }
+   Shape withEmptyLayersCollapsed() const { Shape ret; int k = 0; for ( int i = 0; i < 4; i++ ) { ret.layers[k] = layers[i]; k += !ret.layers[k].isEmpty(); } return ret; }
+   Shape cutRight() const { Shape ret; for ( int i = 0; i < 4; i++ ) ret.layers[i] = layers[i].cutRight(); return ret.withEmptyLayersCollapsed(); }
+   Shape cutLeft() const { Shape ret; for ( int i = 0; i < 4; i++ ) ret.layers[i] = layers[i].cutLeft(); return ret.withEmptyLayersCollapsed(); }
+   Shape cut( int keptQuadrants ) const { Shape ret; for ( int i = 0; i < 4; i++ ) ret.layers[i] = layers[i].b & keptQuadrants; return ret.withEmptyLayersCollapsed(); }
+   bool intersects( const Shape& b, int bLayerOffset ) const { for ( int i = bLayerOffset; i < 4; i++ ) if ( layers[i].intersects( b.layers[i-bLayerOffset] ) ) return true; return false; }
+   uint16_t code() const { return layers[0].b | (layers[1].b << 4) | (layers[2].b << 8) | (layers[3].b << 12); }
+   static Shape fromCode( uint16_t q ) { Shape ret; ret.layers[0].b = q&15; ret.layers[1].b = (q>>4)&15; ret.layers[2].b = (q>>8)&15; ret.layers[3].b = (q>>12)&15; return ret; }
+   bool hasFloatingLayer() const { for ( int i = 0; i < 3; i++ ) if ( layers[i+1].b && (layers[i+1].b & layers[i].b) == 0 ) return true; return false; }
+   Shape orientated( int k ) const
+   {
+      Shape ret = *this;
+      if ( k&4 ) ret = ret.flipped();
+      if ( k&2 ) ret = ret.rotated().rotated();
+      if ( k&1 ) ret = ret.rotated();
+      return ret;
+   }
+   Shape canonicalized() const
+   {
+      uint16_t ret = code();
+      for ( int i = 1; i < 8; i++ )
+         ret = std::min( ret, orientated( i ).code() );
+      return Shape::fromCode( ret );
+   }
+   bool isCanonical() const
+   {
+      return code() == canonicalized().code();
+   }
+
+public:
+   Layer layers[4];
+};
+
+inline int bLayerOffsetForStacking( const Shape& a, const Shape& b )
+{
+   int bLayerOffset;
+   for ( bLayerOffset = a.numLayers() - 1; bLayerOffset >= 0; bLayerOffset-- )
+      if ( a.intersects( b, bLayerOffset ) )
+      {
+         bLayerOffset++;
+         break;
+      }
+   return std::max( bLayerOffset, 0 );
+}
+
+// stack b onto a
+inline Shape stack( const Shape& a, const Shape& b )
+{
+   Shape ret;
+
+   int bLayerOffset = bLayerOffsetForStacking( a, b );
+
+   for ( int i = 0; i < bLayerOffset; i++ )
+      ret.layers[i] = a.layers[i];
+   for ( int i = bLayerOffset; i < 4; i++ )
+      ret.layers[i] = a.layers[i].b | b.layers[i-bLayerOffset].b;
+
+   return ret;
+}
+
+class Rect
+{
+public:
+   Rect( XY pt0, XY pt1 ) : _Pt0(pt0), _Pt1(pt1) {}
+   XY size() { return _Pt1 - _Pt0; }
+   Rect operator|( const Rect& rhs ) const 
+   { 
+      return Rect( XY( std::min( _Pt0.x, rhs._Pt0.x ), std::min( _Pt0.y, rhs._Pt0.y ) )
+                   , XY( std::max( _Pt1.x, rhs._Pt1.x ), std::max( _Pt1.y, rhs._Pt1.y ) ) );
+   }
+
+public:
+   XY _Pt0;
+   XY _Pt1;
+};
+
+//5: compact merger
+//6: compact merger
+//7: extractor
+//8: extractor
+//9: cut
+//10: 4-way cut
+//11: rotate clock
+//12: rotate counter-clock
+//13: rotate 180
+//14: stacker
+//15: mixer
+//16: painter
+//17: painter-flip
+//18: painter 2x
+//19: painter 4x
+//20: trash
+//21: storage
+//22: tunnel in
+//23: tunnel out (long)
+//24: tunnel in
+//25: tunnel out (long)
+//61: item producer
+
+enum BuildingType : int 
+{  
+   BELT = 1,
+   BELT_LEFT = 2,
+   BELT_RIGHT = 3,
+   MERGER_LEFT = 6,   // compact merger, second input from the left side
+   SPLITTER_LEFT = 8, // compact splitter, second output to the left side
+   CUTTER = 9,
+   QUAD_CUTTER = 10,
+   ROTATOR_1 = 11,
+   ROTATOR_2 = 13,
+   ROTATOR_3 = 12,
+   STACKER = 14,
+   TRASH = 20,
+   TUNNEL_IN = 22,
+   TUNNEL_OUT = 23,
+   CONSTANT_SIGNAL = 31,
+   PRODUCER = 61
+};
+
+enum Op : uint8_t { NONE=0, RAW=1, STACK=2, CUT_LEFT=3, CUT_RIGHT=4, ROTATE_1=5, ROTATE_2=6, ROTATE_3=7,
+                    QUAD_CUT_TR=8, QUAD_CUT_BR=9, QUAD_CUT_BL=10, QUAD_CUT_TL=11, NUM_OPS=12 };
+
+enum OpKind : uint8_t { NO_OP=0, RAW_OP=1, STACK_OP=2, CUT_OP=3, ROTATE_OP=4 };
+
+// What each op does. The kind decides the op's cost (rotate/cut/stack) and how it is laid out; the generator,
+// mappings, metrics, blueprints and the simulator all go through this table.
+struct OpInfo
+{
+   Op op;
+   const char* name;
+   OpKind kind;
+   uint8_t keptQuadrants; // CUT_OP: quadrant bits of the input that come out (on outputSlot), the rest is trashed
+   uint8_t outputSlot;
+   uint8_t numRotations;  // ROTATE_OP: quarter turns clockwise
+   BuildingType building;
+};
+
+inline const OpInfo& opInfo( Op op )
+{
+   static const OpInfo table[NUM_OPS] = {
+      { NONE, "UNKNOWN-OP", NO_OP, 0, 0, 0, BELT },
+      { RAW, "RAW", RAW_OP, 0, 0, 0, PRODUCER },
+      { STACK, "STACK", STACK_OP, 0, 0, 0, STACKER },
+      { CUT_LEFT, "CUT_LEFT", CUT_OP, 12, 0, 0, CUTTER },
+      { CUT_RIGHT, "CUT_RIGHT", CUT_OP, 3, 1, 0, CUTTER },
+      { ROTATE_1, "ROTATE_1", ROTATE_OP, 0, 0, 1, ROTATOR_1 },
+      { ROTATE_2, "ROTATE_2", ROTATE_OP, 0, 0, 2, ROTATOR_2 },
+      { ROTATE_3, "ROTATE_3", ROTATE_OP, 0, 0, 3, ROTATOR_3 },
+      { QUAD_CUT_TR, "QUAD_CUT_TR", CUT_OP, 1, 0, 0, QUAD_CUTTER },
+      { QUAD_CUT_BR, "QUAD_CUT_BR", CUT_OP, 2, 1, 0, QUAD_CUTTER },
+      { QUAD_CUT_BL, "QUAD_CUT_BL", CUT_OP, 4, 2, 0, QUAD_CUTTER },
+      { QUAD_CUT_TL, "QUAD_CUT_TL", CUT_OP, 8, 3, 0, QUAD_CUTTER },
+   };
+   return table[op < NUM_OPS ? op : NONE];
+}
+
+// the result of a one-input op
+inline Shape applyOp( Op op, const Shape& a )
+{
+   const OpInfo& info = opInfo( op );
+   if ( info.kind == CUT_OP )
+      return a.cut( info.keptQuadrants );
+   Shape ret = a;
+   for ( int i = 0; i < info.numRotations; i++ )
+      ret = ret.rotated();
+   return ret;
+}
+
+// which ops the generators and searches may use
+typedef uint32_t OpMask;
+inline OpMask opBit( Op op ) { return 1u << op; }
+const OpMask CLASSIC_OPS = 0xFE; // RAW..ROTATE_3, what the recipe tables have always been made of
+const OpMask ALL_OPS = CLASSIC_OPS | opBit( QUAD_CUT_TR ) | opBit( QUAD_CUT_BR ) | opBit( QUAD_CUT_BL ) | opBit( QUAD_CUT_TL );
+
+struct Mapping // where does each bit end up
+{
+   int m[16];
+
+   Mapping() 
+   {
+      for ( int i = 0; i < 16; i++ )
+         m[i] = -1;
+   }
+
+   static Mapping identity() {
+      Mapping ret;
+      for ( int i = 0; i < 16; i++ )
+         ret.m[i] = i;
+      return ret;
+   }
+
+   int operator[]( int idx ) const { return idx >= 0 && idx < 16 ? m[idx] : -1; }
+
+   Mapping operator*( const Mapping& rhs ) const
+   {
+      Mapping ret;
+      for ( int i = 0; i < 16; i++ )
+         ret.m[i] = (*this)[rhs[i]];
+      return ret;
+   }
+};
+
+#pragma pack(push, 1)
+struct Recipe
+{
+   uint16_t a = 0;
+   uint16_t b = 0;
+   Op op = NONE;
+
+   Mapping mappingForA() const
+   {
+      if ( op == RAW ) 
+      {
+         Mapping ret;
+         for ( int i = 0; i < 16; i++ )
+            ret.m[i] = i;
+         return ret;
+      }
+      if ( op == STACK )
+      {
+         return Mapping::identity();
+      }
+      if ( opInfo( op ).kind == CUT_OP )
+      {
+         Shape shape = Shape::fromCode( a );
+
+         int mask = opInfo( op ).keptQuadrants;
+
+         int layerHasSomething[4] = {
+            ((shape.layers[0].b & mask) ? 1 : 0),
+            ((shape.layers[1].b & mask) ? 1 : 0),
+            ((shape.layers[2].b & mask) ? 1 : 0),
+            ((shape.layers[3].b & mask) ? 1 : 0)
+         };
+
+         int layerMapping[4];
+         layerMapping[0] = 0;
+         layerMapping[1] = layerHasSomething[0];
+         layerMapping[2] = layerHasSomething[0] + layerHasSomething[1];
+         layerMapping[3] = layerHasSomething[0] + layerHasSomething[1] + layerHasSomething[2];
+
+         Mapping ret;
+         for ( int i = 0; i < 16; i++ )
+            ret.m[i] = layerHasSomething[i/4] && (mask & (1 << (i&3))) ? layerMapping[i/4]*4 + (i&3) : -1;
+         return ret;
+      }
+
+      //if ( op == CUT_RIGHT ) return "CUT_RIGHT";
+
+
+      Mapping rotateMapping;
+      for ( int i = 0; i < 16; i++ )
+         rotateMapping.m[i] = ((i+1)&3) | (i&12);
+
+      if ( opInfo( op ).kind == ROTATE_OP )
+      {
+         Mapping ret = Mapping::identity();
+         for ( int i = 0; i < opInfo( op ).numRotations; i++ )
+            ret = ret * rotateMapping;
+         return ret;
+      }
+
+      throw 777;
+   }
+
+   Mapping mappingForB() const
+   {
+      int bLayerOffset = bLayerOffsetForStacking( Shape::fromCode( a ), Shape::fromCode( b ) );
+      if ( op == STACK )
+      {
+         Mapping ret;
+         for ( int i = 0; i < 16; i++ )
+            ret.m[i] = i + bLayerOffset*4;
+         return ret;
+      }
+      throw 777;
+   }
+};
+#pragma pack(pop)
+
+struct ShapeInfo
+{
+   int bestCost;
+   Recipe recipe;
+};
+
+inline XY buildingSize( BuildingType type )
+{
+   if ( type == CUTTER ) return XY(2,1);
+   if ( type == QUAD_CUTTER ) return XY(4,1);
+   if ( type == STACKER ) return XY(2,1);
+   return XY(1,1);
+}
+
+// {"components":{"StaticMapEntity":{"origin":{"x":X,"y":Y},"rotation":ROTATION,"originalRotation":0,"code":CODE}EXTRA_JSON}}
+inline void appendBuildingJson( std::string& json, BuildingType type, XY pos, int rotation, const std::string& extraJson )
+{
+   json += R"({"components":{"StaticMapEntity":{"origin":{"x":)";
+   json += std::to_string( pos.x );
+   json += R"(,"y":)";
+   json += std::to_string( pos.y );
+   json += R"(},"rotation":)";
+   json += std::to_string( rotation*90 );
+   json += R"(,"originalRotation":0,"code":)";
+   json += std::to_string( (int)type );
+   json += "}";
+   json += extraJson;
+   json += "}}";
+}
+
+inline std::string constantSignalJson( const std::string& code )
+{
+   return R"(,"ConstantSignal":{"signal":{"$":"shape","data":")" + code + R"("}})";
+}
+
+class Building
+{
+public:
+   Building( BuildingType type, XY pos, int rotation = 0 ) : _Type(type), _Pos(pos), _Rotation(rotation) {}
+   virtual std::string toJson() const
+   {
+      std::string j;
+      appendBuildingJson( j, _Type, _Pos, _Rotation, extraJson() );
+      return j;
+   }
+   virtual std::string extraJson() const
+   {
+      return "";
+   }
+   virtual std::shared_ptr<Building> clone( XY offset ) const
+   {
+      return std::shared_ptr<Building>( new Building( _Type, _Pos + offset, _Rotation ) );
+   }
+   virtual Rect rect() const 
+   { 
+      XY sz = buildingSize( _Type );
+      if ( _Rotation == 0 ) return Rect( _Pos, _Pos + sz ); 
+      if ( _Rotation == 1 ) return Rect( XY( _Pos.x-sz.y+1, _Pos.y ), XY( _Pos.x+1, _Pos.y+sz.x ) ); 
+      if ( _Rotation == 2 ) return Rect( _Pos - sz + XY(1,1), _Pos + XY(1,1) ); 
+      if ( _Rotation == 3 ) return Rect( XY( _Pos.x, _Pos.y-sz.x+1 ), XY( _Pos.x+sz.y, _Pos.y+1 ) );
+      throw 777;
+   }
+
+public:
+   BuildingType _Type;
+   XY _Pos;
+   int _Rotation;
+};
+
+
+inline std::string codeForShape( const Shape& shape, const std::string& finalTarget, const Mapping& mapping )
+{
+   std::string ret;
+   for ( int layer = 0; layer < shape.numLayers(); layer++ )
+   {
+      if ( layer > 0 )
+         ret += ":";
+      for ( int b = 0; b < 4; b++ )
+      {
+         int targetIdx = mapping[layer*4+b];
+         if ( !(shape.layers[layer].b & (1<<b)) )
+            ret += "--";
+         else
+            ret += targetIdx >= 0 ? finalTarget.substr( targetIdx*2 + targetIdx/4, 2 ) : "Cu";
+      }
+   }
+   return ret;
+}
+
+class ConstantShapeSignal : public Building
+{
+public:
+   ConstantShapeSignal( Shape shape, const std::string& code, XY pos, int rotation = 0 ) : Building( CONSTANT_SIGNAL, pos, rotation ), _Shape( shape ), _Code( code ) {}
+   std::string extraJson() const override
+   {
+      return constantSignalJson( _Code /*_Shape.str()*/ );
+   }
+   std::shared_ptr<Building> clone( XY offset ) const override
+   {
+      return std::shared_ptr<Building>( new ConstantShapeSignal( _Shape, _Code, _Pos + offset, _Rotation ) );
+   }
+
+public:
+   Shape _Shape;
+   std::string _Code;
+};
+
+class BluePrint
+{
+public:
+   void add( const std::shared_ptr<Building>& building )
+   {
+      _Buildings.push_back( building );
+   }
+   void add( const BluePrint& bp, XY offset )
+   {
+      for ( const std::shared_ptr<Building>& building : bp._Buildings )
+         _Buildings.push_back( building->clone( offset ) );
+   }
+   Rect rect() const
+   {
+      Rect ret = { XY(9999,9999), XY(-9999,-9999) };
+      for ( const std::shared_ptr<Building>& building : _Buildings )
+         ret = ret | building->rect();
+      return ret;
+   }
+   std::string toJson() const
+   {
+      std::stringstream ss;
+      ss << "[" << std::endl;
+      int first = true;
+      for ( const std::shared_ptr<Building>& building : _Buildings )
+      {
+         ss << (first?"":",") << building->toJson()<< std::endl;
+         first = false;
+      }
+      ss << "]" << std::endl;
+      return ss.str();
+   }
+
+public:
+   std::vector<std::shared_ptr<Building>> _Buildings;
+};
+
+//ShapeInfo g_shapeInfo[1<<16];
+//uint8_t g_shapeIsPossible[1<<16] = { 0 };
+
+
+inline std::string opStr( Op op )
+{
+   return opInfo( op ).name;
+}
+
+const int IMPOSSIBLE_COST = 99999999;
+
+inline int opCost( Op op, int rotateCost, int cutCost, int stackCost )
+{
+   OpKind kind = opInfo( op ).kind;
+   if ( kind == STACK_OP ) return stackCost;
+   if ( kind == CUT_OP ) return cutCost;
+   if ( kind == ROTATE_OP ) return rotateCost;
+   return 0;
+}
+
+
+inline Shape shapeFromCode( const std::string& code )
+{
+   Shape shape;
+   for ( int layer = 0; layer < 4; layer++ )
+   {
+      for ( int b = 0; b < 4; b++ )
+      {
+         int strIndex = layer*9 + b*2;
+         if ( strIndex+2 <= (int)code.length() && code.substr( strIndex, 2 ) != "--" )
+            shape.layers[layer].b |= 1 << b;
+      }
+   }
+
+   return shape;
+}
+
+
+inline int popCount( uint64_t x ) { return (int) std::bitset<64>( x ).count(); }
+inline int lowestBitIndex( uint64_t x ) { return popCount( (x & (~x+1)) - 1 ); }
+
+// one bit per shape code
+class ShapeSet
+{
+public:
+   static const int NUM_WORDS = (1<<16) / 64;
+
+   ShapeSet() { clear(); }
+
+   void clear() { std::fill( _Words, _Words + NUM_WORDS, 0 ); }
+   bool operator[]( int code ) const { return (_Words[code>>6] >> (code&63)) & 1; }
+   void set( int code, bool value = true )
+   {
+      if ( value ) _Words[code>>6] |= 1ull << (code&63);
+      else         _Words[code>>6] &= ~(1ull << (code&63));
+   }
+
+   int count() const { int ret = 0; for ( int i = 0; i < NUM_WORDS; i++ ) ret += popCount( _Words[i] ); return ret; }
+   int countIntersection( const ShapeSet& rhs ) const { int ret = 0; for ( int i = 0; i < NUM_WORDS; i++ ) ret += popCount( _Words[i] & rhs._Words[i] ); return ret; }
+   int countDifference( const ShapeSet& rhs ) const { int ret = 0; for ( int i = 0; i < NUM_WORDS; i++ ) ret += popCount( _Words[i] & ~rhs._Words[i] ); return ret; }
+
+   ShapeSet operator&( const ShapeSet& rhs ) const { ShapeSet ret; for ( int i = 0; i < NUM_WORDS; i++ ) ret._Words[i] = _Words[i] & rhs._Words[i]; return ret; }
+   ShapeSet operator|( const ShapeSet& rhs ) const { ShapeSet ret; for ( int i = 0; i < NUM_WORDS; i++ ) ret._Words[i] = _Words[i] | rhs._Words[i]; return ret; }
+   ShapeSet operator-( const ShapeSet& rhs ) const { ShapeSet ret; for ( int i = 0; i < NUM_WORDS; i++ ) ret._Words[i] = _Words[i] & ~rhs._Words[i]; return ret; }
+   ShapeSet operator~() const { ShapeSet ret; for ( int i = 0; i < NUM_WORDS; i++ ) ret._Words[i] = ~_Words[i]; return ret; }
+   ShapeSet& operator&=( const ShapeSet& rhs ) { for ( int i = 0; i < NUM_WORDS; i++ ) _Words[i] &= rhs._Words[i]; return *this; }
+   ShapeSet& operator|=( const ShapeSet& rhs ) { for ( int i = 0; i < NUM_WORDS; i++ ) _Words[i] |= rhs._Words[i]; return *this; }
+   bool operator==( const ShapeSet& rhs ) const { return std::equal( _Words, _Words + NUM_WORDS, rhs._Words ); }
+
+   // calls f( code ) for every code in the set, in increasing order
+   template<class F> void forEach( F f ) const
+   {
+      for ( int i = 0; i < NUM_WORDS; i++ )
+         for ( uint64_t w = _Words[i]; w; w &= w-1 )
+            f( i*64 + lowestBitIndex( w ) );
+   }
+
+   static ShapeSet fromPredicate( const std::function<bool(const Shape&)>& predicate )
+   {
+      ShapeSet ret;
+      for ( int code = 0; code < (1<<16); code++ )
+         if ( predicate( Shape::fromCode( code ) ) )
+            ret.set( code );
+      return ret;
+   }
+
+   void writeToFile( const std::string& filename ) const
+   {
+      std::ofstream f( filename, std::ios::binary );
+      f.write( (const char*) _Words, sizeof(_Words) );
+   }
+   bool loadFromFile( const std::string& filename )
+   {
+      std::ifstream f( filename, std::ios::binary );
+      f.read( (char*) _Words, sizeof(_Words) );
+      return f.good();
+   }
+
+public:
+   uint64_t _Words[NUM_WORDS];
+};
+
+
+// Inverted recipe table: for each code, the codes whose recipe takes it as an input, in compressed sparse rows (the
+// users of code c are _Users[_Offsets[c]] .. _Users[_Offsets[c+1]-1], in increasing order).
+class RecipeUsers
+{
+public:
+   RecipeUsers() : _Offsets( (1<<16) + 1, 0 ) {}
+   explicit RecipeUsers( const std::vector<Recipe>& recipes ) : RecipeUsers()
+   {
+      build( recipes );
+   }
+
+   void build( const std::vector<Recipe>& recipes )
+   {
+      std::fill( _Offsets.begin(), _Offsets.end(), 0 );
+      for ( int code = 1; code < (int) recipes.size(); code++ )
+         forEachInput( recipes[code], [&]( uint16_t input ) { _Offsets[input+1]++; } );
+      for ( int i = 1; i < (int) _Offsets.size(); i++ )
+         _Offsets[i] += _Offsets[i-1];
+
+      _Users.resize( _Offsets.back() );
+      std::vector<uint32_t> next( _Offsets.begin(), _Offsets.end() - 1 );
+      for ( int code = 1; code < (int) recipes.size(); code++ )
+         forEachInput( recipes[code], [&]( uint16_t input ) { _Users[next[input]++] = (uint16_t) code; } );
+   }
+
+   int numUsers( uint16_t code ) const { return (int) (_Offsets[code+1] - _Offsets[code]); }
+   const uint16_t* usersBegin( uint16_t code ) const { return _Users.data() + _Offsets[code]; }
+   const uint16_t* usersEnd( uint16_t code ) const { return _Users.data() + _Offsets[code+1]; }
+
+   // the codes and every code whose recipe tree contains one of them
+   ShapeSet dependents( const ShapeSet& codes ) const
+   {
+      ShapeSet ret = codes;
+      std::vector<uint16_t> todo;
+      codes.forEach( [&]( int code ) { todo.push_back( (uint16_t) code ); } );
+      while ( !todo.empty() )
+      {
+         uint16_t code = todo.back();
+         todo.pop_back();
+         for ( const uint16_t* user = usersBegin( code ); user != usersEnd( code ); user++ )
+            if ( !ret[*user] )
+            {
+               ret.set( *user );
+               todo.push_back( *user );
+            }
+      }
+      return ret;
+   }
+   ShapeSet dependents( uint16_t code ) const
+   {
+      ShapeSet codes;
+      codes.set( code );
+      return dependents( codes );
+   }
+
+private:
+   // (a shape stacked on itself is one input)
+   template<class F> static void forEachInput( const Recipe& recipe, F f )
+   {
+      if ( recipe.op == NONE || recipe.op == RAW )
+         return;
+      f( recipe.a );
+      if ( recipe.op == STACK && recipe.b != recipe.a )
+         f( recipe.b );
+   }
+
+public:
+   std::vector<uint32_t> _Offsets;
+   std::vector<uint16_t> _Users;
+};
+
+class Recipes
+{
+public:
+   static const int MAX_DEPTH = 256; // of a recipe tree; generated tables stay far below (recipes_0_1_1.bin: 10)
+
+   Recipes()
+   {
+      _Recipes.resize( 1<<16 );
+   }
+   Recipes( const std::string& filename ) : Recipes()
+   {
+      loadFromFile( filename );
+   }
+
+   const Recipe& operator[]( int index ) const { return _Recipes[index]; }
+   Recipe& operator[]( int index ) { return _Recipes[index]; }
+
+   std::string recipeTreeFor( const Shape& shape, const std::string& prefix ) const
+   {
+      std::stringstream ss;
+      const Recipe& recipe = _Recipes[shape.code()];
+      ss << prefix << shape.str() << " " << opStr( recipe.op ) <<  std::endl;
+      if ( recipe.a )
+         ss << recipeTreeFor( Shape::fromCode( recipe.a ), prefix + "  " );
+      if ( recipe.b )
+         ss << recipeTreeFor( Shape::fromCode( recipe.b ), prefix + "  " );
+      return ss.str(); 
+   }
+
+   // empty if the table has no recipe for it, or its recipe tree needs an op that isn't in `ops`
+   BluePrint bluePrintFor( const std::string& finalTarget, OpMask ops = ALL_OPS ) const
+   {
+      if ( !isPossible( shapeFromCode( finalTarget ).code(), ops ) )
+         return BluePrint();
+      return bluePrintFor( shapeFromCode( finalTarget ), finalTarget, Mapping::identity() );
+   }
+   BluePrint bluePrintFor( const Shape& shape, const std::string& finalTarget, const Mapping& mapping ) const
+   {
+      BluePrint ret;
+
+      const Recipe& recipe = _Recipes[shape.code()];
+      const OpInfo& info = opInfo( recipe.op );
+      if ( info.kind == RAW_OP )
+      {
+         ret.add( std::shared_ptr<Building>( new Building( BELT, XY(0,0), 0 ) ) );
+         ret.add( std::shared_ptr<Building>( new Building( BELT, XY(0,1), 0 ) ) );
+         ret.add( std::shared_ptr<Building>( new Building( BELT, XY(0,2), 0 ) ) );
+         ret.add( std::shared_ptr<Building>( new Building( BELT, XY(0,3), 0 ) ) );
+         ret.add( std::shared_ptr<Building>( new Building( info.building, XY(0,4), 0 ) ) );
+         ret.add( std::shared_ptr<Building>( new ConstantShapeSignal( shape, codeForShape( shape, finalTarget, mapping ), XY(0,5), 0 ) ) );
+      }
+      if ( info.kind == STACK_OP )
+      {
+         ret.add( std::shared_ptr<Building>( new Building( info.building, XY(0,0), 0 ) ) );
+         BluePrint a = bluePrintFor( Shape::fromCode( recipe.a ), finalTarget, mapping * recipe.mappingForA() );
+         BluePrint b = bluePrintFor( Shape::fromCode( recipe.b ), finalTarget, mapping * recipe.mappingForB() );
+
+         int bx = a.rect()._Pt1.x;
+         ret.add( a, XY(0,2) );
+         ret.add( b, XY(bx,0) + XY(0,2) );
+         ret.add( std::shared_ptr<Building>( new Building( BELT, XY(0,1), 0 ) ) );
+
+         if ( bx == 1 )
+         {
+            ret.add( std::shared_ptr<Building>( new Building( BELT, XY(bx,1), 0 ) ) );
+         }
+         else
+         {
+            ret.add( std::shared_ptr<Building>( new Building( BELT_RIGHT, XY(1,1), 3 ) ) );
+            for ( int x = 2; x < bx; x++ )
+               ret.add( std::shared_ptr<Building>( new Building( BELT, XY(x,1), 3 ) ) );
+            ret.add( std::shared_ptr<Building>( new Building( BELT_LEFT, XY(bx,1), 0 ) ) );
+         }
+      }
+      if ( info.kind == CUT_OP )
+      {
+         // the kept part comes out of tile `slot` and is brought back to x = 0, the other outputs are trashed
+         int slot = info.outputSlot;
+         ret.add( std::shared_ptr<Building>( new Building( info.building, XY(0,2), 0 ) ) );
+         for ( int x = 0; x < buildingSize( info.building ).x; x++ )
+            if ( x != slot )
+               ret.add( std::shared_ptr<Building>( new Building( TRASH, XY(x,1), 0 ) ) );
+         if ( slot == 0 )
+         {
+            ret.add( std::shared_ptr<Building>( new Building( BELT, XY(0,0), 0 ) ) );
+            ret.add( std::shared_ptr<Building>( new Building( BELT, XY(0,1), 0 ) ) );
+         }
+         else
+         {
+            ret.add( std::shared_ptr<Building>( new Building( BELT_RIGHT, XY(0,0), 3 ) ) );
+            for ( int x = 1; x < slot; x++ )
+               ret.add( std::shared_ptr<Building>( new Building( BELT, XY(x,0), 3 ) ) );
+            ret.add( std::shared_ptr<Building>( new Building( BELT_LEFT, XY(slot,0), 0 ) ) );
+            ret.add( std::shared_ptr<Building>( new Building( BELT, XY(slot,1), 0 ) ) );
+         }
+         BluePrint a = bluePrintFor( Shape::fromCode( recipe.a ), finalTarget, mapping * recipe.mappingForA() );
+         ret.add( a, XY(0,3) );
+      }
+      if ( info.kind == ROTATE_OP )
+      {
+         ret.add( std::shared_ptr<Building>( new Building( info.building, XY(0,0), 0 ) ) );
+         BluePrint a = bluePrintFor( Shape::fromCode( recipe.a ), finalTarget, mapping * recipe.mappingForA() );
+         ret.add( a, XY(0,1) );
+      }
+
+      return ret;
+   }
+
+   void writeToFile( const std::string& filename )
+   {
+      std::ofstream f(filename, std::ios::binary);
+      f.write( (const char*) _Recipes.data(), _Recipes.size()*sizeof(Recipe) );
+      std::trace << "wrote recipes here: " << filename << std::endl;
+   }
+   bool loadFromFile( const std::string& filename )
+   {
+      std::ifstream f(filename, std::ios::binary);
+      f.read( (char*) _Recipes.data(), _Recipes.size()*sizeof(Recipe) );
+      indexUsers();
+      return f.good() && isValid();
+   }
+
+   // rebuilds users() after the recipes were changed through operator[]
+   void indexUsers() { _Users.build( _Recipes ); }
+   const RecipeUsers& users() const { return _Users; }
+
+   // (the empty shape has a recipe in the tables, as a by-product of cutting, but is not a shape)
+   bool isPossible( int code ) const { return code != 0 && _Recipes[code].op != NONE; }
+   // with only `ops`: a table has one recipe per code, so this is whether its recipe tree needs no other op (for
+   // the best recipes without some ops, generate a table with them masked out)
+   bool isPossible( int code, OpMask ops ) const { return isPossible( code ) && !(opsFor( code ) & ~ops); }
+
+   // the ops of the recipe tree of `code`
+   OpMask opsFor( int code ) const
+   {
+      const Recipe& recipe = _Recipes[code];
+      if ( !isPossible( code ) )
+         return 0;
+      OpMask ret = opBit( recipe.op );
+      if ( recipe.op != RAW ) ret |= opsFor( recipe.a );
+      if ( recipe.op == STACK ) ret |= opsFor( recipe.b );
+      return ret;
+   }
+
+   ShapeSet possibleShapes() const
+   {
+      ShapeSet ret;
+      for ( int i = 0; i < (int) _Recipes.size(); i++ )
+         if ( isPossible( i ) )
+            ret.set( i );
+      return ret;
+   }
+
+   // all possible codes, ordered so that every recipe comes after the recipes of its inputs
+   std::vector<uint16_t> bottomUpOrder() const
+   {
+      std::vector<uint16_t> ret;
+      std::vector<bool> visited( _Recipes.size(), false );
+      for ( int i = 0; i < (int) _Recipes.size(); i++ )
+         addBottomUp( i, visited, ret );
+      return ret;
+   }
+
+   // whether every recipe has a known op and possible inputs, and no recipe tree contains itself or is deeper than
+   // MAX_DEPTH; tables from files or memory are checked before anything recurses down their recipe trees
+   // (iterative, so a bad table can't overflow the stack here either)
+   bool isValid() const
+   {
+      enum { NEW=0, OPEN=1, DONE=2 };
+      std::vector<uint8_t> state( _Recipes.size(), NEW );
+      std::vector<int> depth( _Recipes.size(), 0 );
+      std::vector<uint16_t> todo;
+      for ( int code = 1; code < (int) _Recipes.size(); code++ )
+      {
+         if ( !isPossible( code ) )
+            continue;
+         todo.push_back( (uint16_t) code );
+         while ( !todo.empty() )
+         {
+            uint16_t c = todo.back();
+            const Recipe& recipe = _Recipes[c];
+            if ( state[c] == DONE )
+            {
+               todo.pop_back();
+               continue;
+            }
+            if ( recipe.op >= NUM_OPS )
+               return false;
+            uint16_t inputs[2] = { recipe.a, recipe.b };
+            int numInputs = recipe.op == RAW ? 0 : recipe.op == STACK ? 2 : 1;
+            if ( state[c] == NEW )
+            {
+               // an input that is still open is one of the codes on the way down to it
+               state[c] = OPEN;
+               for ( int i = 0; i < numInputs; i++ )
+               {
+                  if ( !isPossible( inputs[i] ) || state[inputs[i]] == OPEN )
+                     return false;
+                  if ( state[inputs[i]] == NEW )
+                     todo.push_back( inputs[i] );
+               }
+               continue;
+            }
+            for ( int i = 0; i < numInputs; i++ )
+               depth[c] = std::max( depth[c], depth[inputs[i]] );
+            if ( ++depth[c] > MAX_DEPTH )
+               return false;
+            state[c] = DONE;
+            todo.pop_back();
+         }
+      }
+      return true;
+   }
+
+   // total cost of each code's recipe tree (IMPOSSIBLE_COST if there is no recipe)
+   std::vector<int> costs( int rotateCost, int cutCost, int stackCost ) const
+   {
+      std::vector<int> ret( _Recipes.size(), IMPOSSIBLE_COST );
+      for ( uint16_t code : bottomUpOrder() )
+      {
+         const Recipe& recipe = _Recipes[code];
+         int cost = opCost( recipe.op, rotateCost, cutCost, stackCost );
+         if ( recipe.op != RAW ) cost += ret[recipe.a];
+         if ( recipe.op == STACK ) cost += ret[recipe.b];
+         ret[code] = cost;
+      }
+      return ret;
+   }
+
+private:
+   void addBottomUp( uint16_t code, std::vector<bool>& visited, std::vector<uint16_t>& order ) const
+   {
+      const Recipe& recipe = _Recipes[code];
+      if ( visited[code] || !isPossible( code ) )
+         return;
+      visited[code] = true;
+      if ( recipe.op != RAW ) addBottomUp( recipe.a, visited, order );
+      if ( recipe.op == STACK ) addBottomUp( recipe.b, visited, order );
+      order.push_back( code );
+   }
+
+public:
+   std::vector<Recipe> _Recipes;
+   RecipeUsers _Users;
+};
+
+class PossibleShapes
+{
+public:
+   bool operator[]( int index ) const { return _IsPossible[index]; }
+   void setIsPossible( int index, bool value ) { _IsPossible.set( index, value ); }
+
+   // one byte per shape
+   void writeToFile( const std::string& filename )
+   {
+      std::vector<uint8_t> bytes( 1<<16 );
+      for ( int i = 0; i < (int) bytes.size(); i++ )
+         bytes[i] = _IsPossible[i] ? 1 : 0;
+      std::ofstream f( filename, std::ios::binary );
+      f.write( (const char*) bytes.data(), bytes.size() );
+      std::trace << "wrote possible shapes here: " << filename << std::endl;
+   }
+   bool loadFromFile( const std::string& filename )
+   {
+      std::vector<uint8_t> bytes( 1<<16 );
+      std::ifstream f( filename, std::ios::binary );
+      f.read( (char*) bytes.data(), bytes.size() );
+      for ( int i = 0; i < (int) bytes.size(); i++ )
+         _IsPossible.set( i, bytes[i] != 0 );
+      return f.good();
+   }
+
+public:
+   ShapeSet _IsPossible;
+};
+
+
+
+// are the quadrants in `mask` free of gaps, i.e. can they be built by stacking single layers
+inline bool isStackable( const Shape& shape, int mask )
+{
+   for ( int i = 0; i < 3; i++ )
+      if ( (shape.layers[i+1].b & mask) && !(shape.layers[i].b & mask) )
+         return false;
+   return true;
+}
+
+inline bool canBeMadeFromTwoHalves( const Shape& shape )
+{
+   return (isStackable( shape, 3 ) && isStackable( shape, 12 ))
+      || (isStackable( shape, 6 ) && isStackable( shape, 9 ));
+}
+
+enum ShapeClass { POSSIBLE=0, CANONICAL=1, FLOATING=2, FROM_TWO_HALVES=3, NUM_SHAPE_CLASSES=4 };
+
+// reachability + structural predicates of every shape code, as bitsets
+class ShapeIndex
+{
+public:
+   ShapeIndex() {}
+   explicit ShapeIndex( const ShapeSet& possible )
+   {
+      _Sets[POSSIBLE] = possible;
+      _Sets[CANONICAL] = ShapeSet::fromPredicate( []( const Shape& shape ) { return shape.isCanonical(); } );
+      _Sets[FLOATING] = ShapeSet::fromPredicate( []( const Shape& shape ) { return shape.hasFloatingLayer(); } );
+      _Sets[FROM_TWO_HALVES] = ShapeSet::fromPredicate( canBeMadeFromTwoHalves );
+   }
+
+   const ShapeSet& operator[]( ShapeClass c ) const { return _Sets[c]; }
+   ShapeSet& operator[]( ShapeClass c ) { return _Sets[c]; }
+
+   void writeToFile( const std::string& filename ) const
+   {
+      std::ofstream f( filename, std::ios::binary );
+      f.write( (const char*) _Sets, sizeof(_Sets) );
+      std::trace << "wrote shape index here: " << filename << std::endl;
+   }
+   bool loadFromFile( const std::string& filename )
+   {
+      std::ifstream f( filename, std::ios::binary );
+      f.read( (char*) _Sets, sizeof(_Sets) );
+      return f.good();
+   }
+
+public:
+   ShapeSet _Sets[NUM_SHAPE_CLASSES];
+};
+
+inline void traceShapeStats( const std::string& recipesFilename )
+{
+   ShapeIndex index( Recipes( recipesFilename ).possibleShapes() );
+
+   ShapeSet possible = index[POSSIBLE] & index[CANONICAL];
+   ShapeSet stackableFromSingleLayers = possible - index[FLOATING];
+   ShapeSet fromTwoHalves = possible & index[FROM_TWO_HALVES];
+
+   std::trace << recipesFilename << std::endl;
+   std::trace << "numPossible = " << index[POSSIBLE].count() << std::endl;
+   std::trace << "numPossibleCanonical = " << possible.count() << std::endl;
+   std::trace << "numStackableFromSingleLayers = " << stackableFromSingleLayers.count() << std::endl;
+   std::trace << "numFromTwoHalves = " << fromTwoHalves.count() << std::endl;
+   std::trace << "numConstructable = " << (stackableFromSingleLayers | fromTwoHalves).count() << std::endl;
+   std::trace << "numPossibleButNotFromTwoHalves = " << possible.countDifference( index[FROM_TWO_HALVES] ) << std::endl;
+}
+
+// a target where some quadrants don't matter, written as a shape code with "??" for each don't-care quadrant
+struct WildcardTarget
+{
+   uint16_t mustHave = 0;
+   uint16_t mustBeEmpty = 0;
+   std::string code;
+
+   bool matches( uint16_t c ) const { return (c & mustHave) == mustHave && !(c & mustBeEmpty); }
+};
+
+inline WildcardTarget wildcardTargetFromCode( const std::string& code )
+{
+   WildcardTarget ret;
+   ret.code = code;
+   for ( int layer = 0; layer < 4; layer++ )
+   {
+      for ( int b = 0; b < 4; b++ )
+      {
+         int strIndex = layer*9 + b*2;
+         std::string quadrant = strIndex+2 <= (int)code.length() ? code.substr( strIndex, 2 ) : "--";
+         if ( quadrant == "--" )
+            ret.mustBeEmpty |= 1 << (layer*4+b);
+         else if ( quadrant != "??" )
+            ret.mustHave |= 1 << (layer*4+b);
+      }
+   }
+   return ret;
+}
+
+// shape code for `code` (a match of `wildcard`) with the colors of the wildcard, don't-care quadrants become "Cu"
+inline std::string concreteTargetFor( const WildcardTarget& wildcard, uint16_t code )
+{
+   Shape shape = Shape::fromCode( code );
+   std::string ret;
+   for ( int layer = 0; layer < shape.numLayers(); layer++ )
+   {
+      if ( layer > 0 )
+         ret += ":";
+      for ( int b = 0; b < 4; b++ )
+      {
+         int strIndex = layer*9 + b*2;
+         std::string quadrant = strIndex+2 <= (int)wildcard.code.length() ? wildcard.code.substr( strIndex, 2 ) : "--";
+         if ( !(shape.layers[layer].b & (1<<b)) )
+            ret += "--";
+         else
+            ret += quadrant != "--" && quadrant != "??" ? quadrant : "Cu";
+      }
+   }
+   return ret;
+}
+
+// cheapest possible code for a (mustHave, mustBeEmpty) pattern.
+// Superset/subset-min table over the 16-bit cost array: layers 0..2 are indexed by one ternary digit
+// per quadrant (0 = empty, 1 = filled, 2 = don't care), layer 3 by its concrete value,
+// so a query reads at most 16 entries.
+class WildcardIndex
+{
+public:
+   static const int TERNARY_BITS = 12;
+   static const int NUM_TERNARY = 531441; // 3^TERNARY_BITS
+
+   explicit WildcardIndex( const std::vector<int>& costs ) : _Costs( costs ), _Best( 16 * NUM_TERNARY, 0 )
+   {
+      // for each ternary pattern: the bits it stands for if it has no don't-care digit, else 3^(lowest don't-care digit)
+      std::vector<uint16_t> concreteBits( NUM_TERNARY, 0 );
+      std::vector<int> lowestDontCare( NUM_TERNARY, 0 );
+      for ( int t = 0; t < NUM_TERNARY; t++ )
+      {
+         int p = 1;
+         for ( int i = 0, x = t; i < TERNARY_BITS; i++, x /= 3, p *= 3 )
+         {
+            if ( x % 3 == 2 ) { lowestDontCare[t] = p; break; }
+            if ( x % 3 == 1 ) concreteBits[t] |= 1 << i;
+         }
+      }
+
+      for ( int top = 0; top < 16; top++ )
+      {
+         uint16_t* best = &_Best[top * NUM_TERNARY];
+         for ( int t = 0; t < NUM_TERNARY; t++ )
+         {
+            int p = lowestDontCare[t];
+            if ( p == 0 )
+            {
+               uint16_t code = concreteBits[t] | (top << TERNARY_BITS);
+               best[t] = _Costs[code] < IMPOSSIBLE_COST ? code : 0;
+            }
+            else
+            {
+               best[t] = better( best[t-p], best[t-2*p] ); // that digit as 1, that digit as 0
+            }
+         }
+      }
+   }
+
+   // 0 if no possible code matches
+   uint16_t cheapest( uint16_t mustHave, uint16_t mustBeEmpty ) const
+   {
+      if ( mustHave & mustBeEmpty )
+         return 0;
+
+      int t = 0;
+      for ( int i = TERNARY_BITS-1; i >= 0; i-- )
+         t = t*3 + ((mustHave>>i)&1 ? 1 : (mustBeEmpty>>i)&1 ? 0 : 2);
+
+      int topHave = mustHave >> TERNARY_BITS;
+      int topFree = ~(mustHave | mustBeEmpty) >> TERNARY_BITS & 15;
+      uint16_t ret = 0;
+      for ( int sub = topFree; ; sub = (sub-1) & topFree )
+      {
+         ret = better( ret, _Best[(topHave | sub) * NUM_TERNARY + t] );
+         if ( sub == 0 )
+            break;
+      }
+      return ret;
+   }
+   uint16_t cheapest( const WildcardTarget& target ) const { return cheapest( target.mustHave, target.mustBeEmpty ); }
+
+   int cost( uint16_t code ) const { return _Costs[code]; }
+
+private:
+   uint16_t better( uint16_t a, uint16_t b ) const
+   {
+      if ( !a ) return b;
+      if ( !b ) return a;
+      return _Costs[b] < _Costs[a] || (_Costs[b] == _Costs[a] && b < a) ? b : a;
+   }
+
+public:
+   std::vector<int> _Costs;
+   std::vector<uint16_t> _Best;
+};
+
+struct ShapeSuggestion
+{
+   uint16_t code;
+   int distance; // number of quadrants that differ from the target
+   int cost;
+};
+
+// closest possible codes to a (possibly impossible) target, by quadrant edit distance and then by cost.
+// Scans the possibility bitset a word at a time: the high 10 bits of the xor with the target are fixed per word,
+// the low 6 bits are handled by precomputed masks of the in-word positions at each distance.
+class NearestShapes
+{
+public:
+   NearestShapes( const ShapeSet& possible, const std::vector<int>& costs ) : _Possible( possible ), _Costs( costs )
+   {
+      for ( int low = 0; low < 64; low++ )
+         for ( int j = 0; j < 64; j++ )
+            _LowMasks[low][popCount( low ^ j )] |= 1ull << j;
+   }
+
+   std::vector<ShapeSuggestion> nearest( uint16_t target, int maxResults ) const
+   {
+      const uint64_t* lowMasks = _LowMasks[target & 63];
+      int high = target >> 6;
+
+      // how many possible codes there are at each distance
+      int numAtDistance[17] = { 0 };
+      for ( int i = 0; i < ShapeSet::NUM_WORDS; i++ )
+      {
+         uint64_t w = _Possible._Words[i];
+         if ( !w )
+            continue;
+         int highDistance = popCount( i ^ high );
+         for ( int k = 0; k <= 6; k++ )
+            numAtDistance[highDistance + k] += popCount( w & lowMasks[k] );
+      }
+
+      int maxDistance = 0;
+      for ( int numSoFar = numAtDistance[0]; maxDistance < 16 && numSoFar < maxResults; )
+         numSoFar += numAtDistance[++maxDistance];
+
+      std::vector<ShapeSuggestion> ret;
+      for ( int i = 0; i < ShapeSet::NUM_WORDS; i++ )
+      {
+         int highDistance = popCount( i ^ high );
+         if ( highDistance > maxDistance )
+            continue;
+         uint64_t mask = 0;
+         for ( int k = 0; k <= 6 && highDistance + k <= maxDistance; k++ )
+            mask |= lowMasks[k];
+         for ( uint64_t w = _Possible._Words[i] & mask; w; w &= w-1 )
+         {
+            uint16_t code = (uint16_t) (i*64 + lowestBitIndex( w ));
+            ret.push_back( { code, popCount( code ^ target ), _Costs[code] } );
+         }
+      }
+
+      std::sort( ret.begin(), ret.end(), []( const ShapeSuggestion& a, const ShapeSuggestion& b ) {
+         if ( a.distance != b.distance ) return a.distance < b.distance;
+         if ( a.cost != b.cost ) return a.cost < b.cost;
+         return a.code < b.code;
+      } );
+      if ( (int) ret.size() > maxResults )
+         ret.resize( maxResults );
+      return ret;
+   }
+
+public:
+   ShapeSet _Possible;
+   std::vector<int> _Costs;
+   uint64_t _LowMasks[64][7] = {};
+};
+
+#pragma pack(push, 1)
+struct RecipeMetrics
+{
+   uint16_t depth = 0;
+   uint16_t numProducers = 0;
+   uint16_t numCutters = 0;
+   uint16_t numStackers = 0;
+   uint16_t numRotators = 0;
+   uint16_t numBelts = 0;
+   uint16_t numBuildings = 0; // 0 if there is no recipe
+   uint16_t width = 0;        // size of Recipes::bluePrintFor's rect()
+   uint16_t height = 0;
+};
+#pragma pack(pop)
+
+enum Metric { DEPTH=0, PRODUCERS=1, CUTTERS=2, STACKERS=3, ROTATORS=4, BELTS=5, BUILDINGS=6, WIDTH=7, HEIGHT=8, AREA=9, NUM_METRICS=10 };
+
+inline int metricValue( const RecipeMetrics& m, Metric metric )
+{
+   if ( metric == DEPTH ) return m.depth;
+   if ( metric == PRODUCERS ) return m.numProducers;
+   if ( metric == CUTTERS ) return m.numCutters;
+   if ( metric == STACKERS ) return m.numStackers;
+   if ( metric == ROTATORS ) return m.numRotators;
+   if ( metric == BELTS ) return m.numBelts;
+   if ( metric == BUILDINGS ) return m.numBuildings;
+   if ( metric == WIDTH ) return m.width;
+   if ( metric == HEIGHT ) return m.height;
+   if ( metric == AREA ) return m.width * m.height;
+   throw 777;
+}
+
+// what Recipes::bluePrintFor would build for each code, without building it
+class RecipeMetricsTable
+{
+public:
+   RecipeMetricsTable() : _Metrics( 1<<16 ) {}
+   explicit RecipeMetricsTable( const Recipes& recipes ) : RecipeMetricsTable()
+   {
+      for ( uint16_t code : recipes.bottomUpOrder() )
+      {
+         const Recipe& recipe = recipes[code];
+         _Metrics[code] = metricsFor( recipe, _Metrics[recipe.a], _Metrics[recipe.b] );
+      }
+      sortByEachMetric();
+   }
+
+   // metrics of `recipe` given those of its inputs (`b` is only used by STACK)
+   static RecipeMetrics metricsFor( const Recipe& recipe, const RecipeMetrics& a, const RecipeMetrics& b )
+   {
+      RecipeMetrics m;
+      if ( recipe.op == RAW )
+      {
+         m.depth = 1;
+         m.numProducers = 1;
+         m.numBelts = 4;
+         m.numBuildings = 6;
+         m.width = 1;
+         m.height = 6;
+         return m;
+      }
+
+      m = a;
+      m.depth = a.depth + 1;
+      if ( recipe.op == STACK )
+      {
+         m.depth = std::max( a.depth, b.depth ) + 1;
+         m.numProducers += b.numProducers;
+         m.numCutters += b.numCutters;
+         m.numStackers += b.numStackers + 1;
+         m.numRotators += b.numRotators;
+         m.numBelts += b.numBelts + a.width + 1;
+         m.numBuildings += b.numBuildings + a.width + 2;
+         m.width = std::max( a.width + b.width, 2 );
+         m.height = std::max( a.height, b.height ) + 2;
+      }
+      if ( opInfo( recipe.op ).kind == CUT_OP )
+      {
+         int slot = opInfo( recipe.op ).outputSlot;
+         int cutterWidth = buildingSize( opInfo( recipe.op ).building ).x;
+         int numBelts = slot == 0 ? 2 : slot + 2;
+         m.numCutters++;
+         m.numBelts += numBelts;
+         m.numBuildings += numBelts + cutterWidth;
+         m.width = std::max( (int) a.width, cutterWidth );
+         m.height = a.height + 3;
+      }
+      if ( opInfo( recipe.op ).kind == ROTATE_OP )
+      {
+         m.numRotators++;
+         m.numBuildings++;
+         m.height = a.height + 1;
+      }
+      return m;
+   }
+
+   // the order the layout-aware generator breaks cost ties in: smaller area, then fewer belts, then fewer buildings
+   static bool hasBetterLayout( const RecipeMetrics& lhs, const RecipeMetrics& rhs )
+   {
+      if ( metricValue( lhs, AREA ) != metricValue( rhs, AREA ) ) return metricValue( lhs, AREA ) < metricValue( rhs, AREA );
+      if ( lhs.numBelts != rhs.numBelts ) return lhs.numBelts < rhs.numBelts;
+      return lhs.numBuildings < rhs.numBuildings;
+   }
+
+   const RecipeMetrics& operator[]( int code ) const { return _Metrics[code]; }
+
+   // the first `n` codes with a recipe, sorted by `metric` (ties in code order)
+   std::vector<uint16_t> cheapestBy( Metric metric, int n ) const
+   {
+      const std::vector<uint16_t>& sorted = sortedBy( metric );
+      return std::vector<uint16_t>( sorted.begin(), sorted.begin() + std::min( n, (int) sorted.size() ) );
+   }
+
+   // sorted once when the metrics are computed or loaded, so a const table can be shared between threads
+   const std::vector<uint16_t>& sortedBy( Metric metric ) const { return _SortedBy[metric]; }
+
+   static std::string filenameFor( const std::string& recipesFilename )
+   {
+      return recipesFilename.substr( 0, recipesFilename.rfind( ".bin" ) ) + "_metrics.bin";
+   }
+   void writeToFile( const std::string& filename ) const
+   {
+      std::ofstream f( filename, std::ios::binary );
+      f.write( (const char*) _Metrics.data(), _Metrics.size()*sizeof(RecipeMetrics) );
+      std::trace << "wrote recipe metrics here: " << filename << std::endl;
+   }
+   bool loadFromFile( const std::string& filename )
+   {
+      std::ifstream f( filename, std::ios::binary );
+      f.read( (char*) _Metrics.data(), _Metrics.size()*sizeof(RecipeMetrics) );
+      sortByEachMetric();
+      return f.good();
+   }
+
+private:
+   void sortByEachMetric()
+   {
+      for ( int metric = 0; metric < NUM_METRICS; metric++ )
+      {
+         std::vector<uint16_t>& sorted = _SortedBy[metric];
+         sorted.clear();
+         for ( int code = 0; code < (int) _Metrics.size(); code++ )
+            if ( _Metrics[code].numBuildings )
+               sorted.push_back( code );
+         std::stable_sort( sorted.begin(), sorted.end(), [&]( uint16_t a, uint16_t b ) { return metricValue( _Metrics[a], (Metric) metric ) < metricValue( _Metrics[b], (Metric) metric ); } );
+      }
+   }
+
+public:
+   std::vector<RecipeMetrics> _Metrics;
+   std::vector<uint16_t> _SortedBy[NUM_METRICS];
+};
+
+// a shape with the 2-letter code of each quadrant (e.g. "Cr"), as in the game's shape codes
+class ColoredShape
+{
+public:
+   ColoredShape() { for ( int i = 0; i < 16; i++ ) { parts[i][0] = '-'; parts[i][1] = '-'; } }
+
+   static ColoredShape fromCode( const std::string& code )
+   {
+      ColoredShape ret;
+      for ( int layer = 0; layer < 4; layer++ )
+      {
+         for ( int b = 0; b < 4; b++ )
+         {
+            int strIndex = layer*9 + b*2;
+            if ( strIndex+2 <= (int)code.length() )
+            {
+               ret.parts[layer*4+b][0] = code[strIndex];
+               ret.parts[layer*4+b][1] = code[strIndex+1];
+            }
+         }
+      }
+      return ret;
+   }
+
+   bool has( int i ) const { return parts[i][0] != '-'; }
+   Shape shape() const { Shape ret; for ( int i = 0; i < 16; i++ ) if ( has( i ) ) ret.layers[i/4].b |= 1 << (i&3); return ret; }
+   std::string code() const
+   {
+      std::string ret;
+      for ( int layer = 0; layer < shape().numLayers(); layer++ )
+      {
+         if ( layer > 0 )
+            ret += ":";
+         for ( int b = 0; b < 4; b++ )
+            ret += std::string( parts[layer*4+b], 2 );
+      }
+      return ret;
+   }
+
+   ColoredShape rotated() const
+   {
+      ColoredShape ret;
+      for ( int i = 0; i < 16; i++ )
+         std::copy( parts[i], parts[i]+2, ret.parts[(i&12) | ((i+1)&3)] );
+      return ret;
+   }
+   // keeps the quadrants in `mask` (3 = right half, 12 = left half, 1 << q = quadrant q), then drops the empty layers like Shape::cutLeft/cutRight
+   ColoredShape cut( int mask ) const
+   {
+      ColoredShape ret;
+      int k = 0;
+      for ( int layer = 0; layer < 4; layer++ )
+      {
+         if ( !(shape().layers[layer].b & mask) )
+            continue;
+         for ( int b = 0; b < 4; b++ )
+            if ( mask & (1<<b) )
+               std::copy( parts[layer*4+b], parts[layer*4+b]+2, ret.parts[k*4+b] );
+         k++;
+      }
+      return ret;
+   }
+   // stack b onto a, like ::stack
+   static ColoredShape stacked( const ColoredShape& a, const ColoredShape& b )
+   {
+      ColoredShape ret = a;
+      int bLayerOffset = bLayerOffsetForStacking( a.shape(), b.shape() );
+      for ( int i = bLayerOffset*4; i < 16; i++ )
+         if ( b.has( i - bLayerOffset*4 ) )
+            std::copy( b.parts[i - bLayerOffset*4], b.parts[i - bLayerOffset*4]+2, ret.parts[i] );
+      return ret;
+   }
+
+public:
+   char parts[16][2];
+};
+
+// processing speeds, in items per second; set them to the upgrade levels in use
+struct BuildingSpeeds
+{
+   double belt = 2;
+   double cutter = 1;
+   double quadCutter = 0.5;
+   double rotator = 2;
+   double stacker = 0.5;
+   double producer = 2;
+
+   double of( BuildingType type ) const
+   {
+      if ( type == BELT || type == BELT_LEFT || type == BELT_RIGHT ) return belt;
+      if ( type == MERGER_LEFT || type == SPLITTER_LEFT || type == TUNNEL_IN || type == TUNNEL_OUT ) return belt;
+      if ( type == CUTTER ) return cutter;
+      if ( type == QUAD_CUTTER ) return quadCutter;
+      if ( type == STACKER ) return stacker;
+      if ( type == ROTATOR_1 || type == ROTATOR_2 || type == ROTATOR_3 ) return rotator;
+      if ( type == PRODUCER ) return producer;
+      return 1e9;
+   }
+};
+
+struct SimulationReport
+{
+   std::map<std::string, int> outputs; // shape code => number of items that left the factory
+   std::string outputShape;            // the most common one
+   double itemsPerSecond = 0;     // of outputShape, measured over the second half of the run
+   int numStalledBuildings = 0;   // buildings that spent more than half of the run blocked on a full output
+   int bottleneck = -1;           // index into the blueprint's buildings of the busiest machine
+   double bottleneckUtilization = 0;
+   std::string error;                  // set if the blueprint can't be simulated
+};
+
+// Headless simulation of a BluePrint on a sparse grid, one tick at a time.
+// Every building holds at most one item per input and output; belts are one-tile machines.
+// Rotation r faces XY::dir-like direction r (0 = up, 1 = right, 2 = down, 3 = left); items enter a building from behind,
+// wider buildings extend to the right. Items that leave towards an empty tile leave the factory. Compact mergers and
+// splitters take or give their second item on their left side; a tunnel entrance feeds the nearest exit ahead of it.
+class FactorySimulator
+{
+public:
+   static const int TICKS_PER_SECOND = 8;
+   static const int OUTSIDE = -1;   // output target: leaves the factory
+   static const int NO_TARGET = -2; // output target: a building that doesn't accept it (stays blocked)
+   static const int MAX_OUTPUTS = 4;
+   static const int TUNNEL_RANGE = 5;
+   static const int WINDOW_SECONDS = 60;     // of output, compared with the windows before by runUntilSteady
+   static const int STEADY_WINDOWS = 3;      // that agree when the blueprint is full
+   static const int MAX_FILL_SECONDS = 3600; // for a blueprint that never settles
+
+   static XY dir( int rotation ) { static XY a[] = { XY(0,-1), XY(1,0), XY(0,1), XY(-1,0) }; return a[rotation&3]; }
+
+   FactorySimulator( const BluePrint& bluePrint, const BuildingSpeeds& speeds = BuildingSpeeds() )
+   {
+      std::map<XY, int> buildingAt;
+      for ( const std::shared_ptr<Building>& building : bluePrint._Buildings )
+      {
+         Machine m;
+         m.type = building->_Type;
+         m.rotation = building->_Rotation;
+         m.numTiles = buildingSize( m.type ).x;
+         for ( int k = 0; k < m.numTiles; k++ )
+         {
+            m.tiles[k] = building->_Pos + dir( m.rotation+1 ) * k;
+            if ( m.type != CONSTANT_SIGNAL )
+               buildingAt[m.tiles[k]] = (int) _Machines.size();
+         }
+         m.period = periodFor( m.type, speeds );
+         if ( const ConstantShapeSignal* signal = dynamic_cast<const ConstantShapeSignal*>( building.get() ) )
+            m.signal = ColoredShape::fromCode( signal->_Code );
+         _Machines.push_back( m );
+      }
+
+      for ( Machine& m : _Machines )
+      {
+         if ( m.type == PRODUCER )
+         {
+            // the signal behind the producer says what it makes
+            m.hasSignal = false;
+            for ( const Machine& other : _Machines )
+               if ( other.type == CONSTANT_SIGNAL && other.tiles[0] == m.tiles[0] - dir( m.rotation ) )
+               {
+                  m.signal = other.signal;
+                  m.hasSignal = true;
+               }
+         }
+         for ( int k = 0; k < numOutputs( m.type ); k++ )
+         {
+            XY from = m.tiles[outputTile( m.type, k )];
+            int d = outputDirection( m, k );
+            if ( m.type == TUNNEL_IN )
+            {
+               m.outTarget[k] = NO_TARGET;
+               for ( int i = 1; i <= TUNNEL_RANGE && m.outTarget[k] == NO_TARGET; i++ )
+               {
+                  auto it = buildingAt.find( from + dir( d ) * i );
+                  if ( it != buildingAt.end() && _Machines[it->second].type == TUNNEL_OUT && _Machines[it->second].rotation == m.rotation )
+                     m.outTarget[k] = it->second;
+               }
+               continue;
+            }
+            auto it = buildingAt.find( from + dir( d ) );
+            m.outTarget[k] = it == buildingAt.end() ? OUTSIDE : NO_TARGET;
+            if ( it != buildingAt.end() && _Machines[it->second].type != TUNNEL_OUT ) // (only fed through its entrance)
+            {
+               const Machine& target = _Machines[it->second];
+               for ( int slot = 0; slot < numInputs( target.type ); slot++ )
+                  if ( target.tiles[inputTile( target.type, slot )] == from + dir( d ) && (target.type == TRASH || (inputDirection( target, slot )&3) == (d&3)) )
+                  {
+                     m.outTarget[k] = it->second;
+                     m.outTargetSlot[k] = slot;
+                  }
+            }
+         }
+      }
+   }
+
+   SimulationReport run( int seconds )
+   {
+      int numTicks = seconds * TICKS_PER_SECOND;
+      std::map<std::string, int> outputsInSecondHalf;
+      SimulationReport report;
+
+      for ( Machine& m : _Machines )
+         if ( m.type == PRODUCER && !m.hasSignal )
+            report.error = "item producer without a constant signal behind it";
+
+      for ( int tick = 0; tick < numTicks; tick++ )
+      {
+         for ( Machine& m : _Machines )
+            if ( m.busy && --m.timer == 0 )
+               finish( m );
+
+         // move items between buildings until nothing moves (each item moves at most once per tick)
+         for ( bool moved = true; moved; )
+         {
+            moved = false;
+            for ( Machine& m : _Machines )
+            {
+               for ( int k = 0; k < numOutputs( m.type ); k++ )
+               {
+                  if ( !m.outFull[k] || m.outTarget[k] == NO_TARGET )
+                     continue;
+                  if ( m.outTarget[k] == OUTSIDE )
+                  {
+                     report.outputs[m.out[k].code()]++;
+                     if ( tick >= numTicks/2 )
+                        outputsInSecondHalf[m.out[k].code()]++;
+                  }
+                  else
+                  {
+                     Machine& target = _Machines[m.outTarget[k]];
+                     int slot = m.outTargetSlot[k];
+                     if ( target.inFull[slot] )
+                        continue;
+                     target.in[slot] = m.out[k];
+                     target.inFull[slot] = true;
+                  }
+                  m.outFull[k] = false;
+                  moved = true;
+               }
+            }
+         }
+
+         for ( Machine& m : _Machines )
+         {
+            if ( !m.busy )
+               tryStart( m );
+            if ( m.busy ) m.busyTicks++;
+            else if ( m.hasFullOutput() ) m.blockedTicks++;
+         }
+      }
+
+      int best = 0;
+      for ( const auto& output : report.outputs )
+         if ( output.second > best )
+         {
+            best = output.second;
+            report.outputShape = output.first;
+         }
+      report.itemsPerSecond = outputsInSecondHalf[report.outputShape] / (double) (numTicks - numTicks/2) * TICKS_PER_SECOND;
+
+      for ( int i = 0; i < (int) _Machines.size(); i++ )
+      {
+         const Machine& m = _Machines[i];
+         if ( m.blockedTicks * 2 > numTicks )
+            report.numStalledBuildings++;
+         double utilization = m.busyTicks / (double) numTicks;
+         if ( isMachine( m.type ) && utilization > report.bottleneckUtilization )
+         {
+            report.bottleneck = i;
+            report.bottleneckUtilization = utilization;
+         }
+      }
+      return report;
+   }
+
+   // runs until the last STEADY_WINDOWS windows made each of `codes` within an item of each other, and some of it, so
+   // that what runs next is measured with the belts full (which takes longer the bigger the blueprint, minutes for
+   // thousands of buildings); returns whether it got there within MAX_FILL_SECONDS
+   bool runUntilSteady( const std::set<std::string>& codes )
+   {
+      std::deque<std::map<std::string, int>> windows;
+      for ( int seconds = 0; seconds < MAX_FILL_SECONDS; seconds += WINDOW_SECONDS )
+      {
+         windows.push_back( run( WINDOW_SECONDS ).outputs );
+         if ( (int) windows.size() > STEADY_WINDOWS )
+            windows.pop_front();
+         bool steady = (int) windows.size() == STEADY_WINDOWS;
+         for ( const std::string& code : codes )
+         {
+            int least = windows.front()[code], most = least;
+            for ( std::map<std::string, int>& window : windows )
+            {
+               least = std::min( least, window[code] );
+               most = std::max( most, window[code] );
+            }
+            steady = steady && least > 0 && most - least <= 1;
+         }
+         if ( steady )
+            return true;
+      }
+      return false;
+   }
+
+private:
+   struct Machine
+   {
+      BuildingType type;
+      int rotation = 0;
+      XY tiles[MAX_OUTPUTS];
+      int numTiles = 1;
+      int period = 1;
+      ColoredShape signal;
+      bool hasSignal = true;
+
+      ColoredShape in[2];
+      bool inFull[2] = { false, false };
+      ColoredShape out[MAX_OUTPUTS];
+      bool outFull[MAX_OUTPUTS] = {};
+      int outTarget[MAX_OUTPUTS] = { NO_TARGET, NO_TARGET, NO_TARGET, NO_TARGET };
+      int outTargetSlot[MAX_OUTPUTS] = {};
+
+      bool busy = false;
+      int timer = 0;
+      ColoredShape result[MAX_OUTPUTS]; // what comes out when the current job finishes
+      bool resultFull[MAX_OUTPUTS] = {};
+
+      bool hasFullOutput() const { return std::find( outFull, outFull + MAX_OUTPUTS, true ) != outFull + MAX_OUTPUTS; }
+      int next = 0; // merger/splitter: the input/output that goes first next time
+
+      int busyTicks = 0;
+      int blockedTicks = 0;
+   };
+
+   static bool isMachine( BuildingType type ) { return type == CUTTER || type == QUAD_CUTTER || type == STACKER || type == ROTATOR_1 || type == ROTATOR_2 || type == ROTATOR_3; }
+   static bool isBelt( BuildingType type ) { return type == BELT || type == BELT_LEFT || type == BELT_RIGHT || type == TUNNEL_IN || type == TUNNEL_OUT; }
+   static int numInputs( BuildingType type ) { return type == STACKER || type == MERGER_LEFT ? 2 : type == PRODUCER || type == CONSTANT_SIGNAL ? 0 : 1; }
+   static int numOutputs( BuildingType type ) { return type == CUTTER || type == SPLITTER_LEFT ? 2 : type == QUAD_CUTTER ? 4 : type == TRASH || type == CONSTANT_SIGNAL ? 0 : 1; }
+   static int inputTile( BuildingType type, int slot ) { return type == MERGER_LEFT ? 0 : slot; }
+   static int outputTile( BuildingType type, int k ) { return type == SPLITTER_LEFT ? 0 : k; }
+   static int inputDirection( const Machine& m, int slot ) { return m.type == MERGER_LEFT && slot == 1 ? m.rotation+1 : m.rotation; }
+   static int outputDirection( const Machine& m, int k )
+   {
+      if ( m.type == SPLITTER_LEFT && k == 1 ) return m.rotation+3;
+      return m.type == BELT_LEFT ? m.rotation+3 : m.type == BELT_RIGHT ? m.rotation+1 : m.rotation;
+   }
+
+   static int periodFor( BuildingType type, const BuildingSpeeds& speeds )
+   {
+      return std::max( 1, (int) std::lround( TICKS_PER_SECOND / speeds.of( type ) ) );
+   }
+
+   void tryStart( Machine& m )
+   {
+      if ( m.type == MERGER_LEFT || m.type == SPLITTER_LEFT )
+      {
+         tryStartBalancer( m );
+         return;
+      }
+      for ( int k = 0; k < numInputs( m.type ); k++ )
+         if ( !m.inFull[k] )
+            return;
+      if ( m.hasFullOutput() )
+         return;
+      if ( m.type == PRODUCER && !m.hasSignal )
+         return;
+
+      std::fill( m.resultFull, m.resultFull + MAX_OUTPUTS, false );
+      if ( m.type == PRODUCER ) { m.result[0] = m.signal; m.resultFull[0] = true; }
+      if ( isBelt( m.type ) ) { m.result[0] = m.in[0]; m.resultFull[0] = true; }
+      // machines do what the ops built with them do; a cutter's tiles each give what the cut op with that output
+      // slot keeps (the left tile the left half)
+      for ( int op = 0; op < NUM_OPS; op++ )
+      {
+         const OpInfo& info = opInfo( (Op) op );
+         if ( info.building != m.type || info.kind == RAW_OP )
+            continue;
+         ColoredShape& result = m.result[info.outputSlot];
+         if ( info.kind == STACK_OP )
+            result = ColoredShape::stacked( m.in[0], m.in[1] );
+         if ( info.kind == ROTATE_OP )
+         {
+            result = m.in[0];
+            for ( int i = 0; i < info.numRotations; i++ )
+               result = result.rotated();
+         }
+         if ( info.kind == CUT_OP )
+            result = m.in[0].cut( info.keptQuadrants );
+         m.resultFull[info.outputSlot] = result.shape().numLayers() > 0;
+      }
+
+      m.inFull[0] = m.inFull[1] = false;
+      m.busy = true;
+      m.timer = m.period;
+   }
+
+   // one item from whichever input has one, to whichever output is free, taking turns when both can
+   void tryStartBalancer( Machine& m )
+   {
+      int numIn = numInputs( m.type );
+      int numOut = numOutputs( m.type );
+      for ( int i = 0; i < numIn; i++ )
+      {
+         int slot = (m.next + i) % numIn;
+         if ( !m.inFull[slot] )
+            continue;
+         for ( int j = 0; j < numOut; j++ )
+         {
+            int k = (m.next + j) % numOut;
+            if ( m.outFull[k] )
+               continue;
+            std::fill( m.resultFull, m.resultFull + MAX_OUTPUTS, false );
+            m.result[k] = m.in[slot];
+            m.resultFull[k] = true;
+            m.inFull[slot] = false;
+            m.next = (numIn > 1 ? slot : k) + 1;
+            m.busy = true;
+            m.timer = m.period;
+            return;
+         }
+         return;
+      }
+   }
+
+   void finish( Machine& m )
+   {
+      m.busy = false;
+      for ( int k = 0; k < MAX_OUTPUTS; k++ )
+         if ( m.resultFull[k] ) // (a splitter's other output may still hold an item)
+         {
+            m.out[k] = m.result[k];
+            m.outFull[k] = true;
+         }
+   }
+
+public:
+   std::vector<Machine> _Machines;
+};
+
+// Cost of recipes in machines needed to run them at a target rate. Every node of a recipe tree passes the full rate
+// (a cut keeps one half per input item, a stack uses one item of each input per output item), so each node needs
+// ceil( rate / speed of its machine ) machines, and these per-operation costs add up like the generator's unit costs.
+struct ThroughputCostModel
+{
+   BuildingSpeeds speeds;
+   double rate = 2; // target items/s
+
+   static int machinesNeeded( double rate, double speed ) { return std::max( 1, (int) std::ceil( rate / speed - 1e-9 ) ); }
+
+   int rotateCost() const { return machinesNeeded( rate, speeds.rotator ); }
+   int cutCost() const { return machinesNeeded( rate, speeds.cutter ); }
+   int stackCost() const { return machinesNeeded( rate, speeds.stacker ); }
+
+   std::vector<int> machines( const Recipes& recipes ) const { return recipes.costs( rotateCost(), cutCost(), stackCost() ); }
+};
+
+// The bus the planners lay their factories out on. Machines stand in row 2, left to right with their output columns
+// between them; their inputs come up from below, their outputs are brought round and down a column to a lane. Lanes
+// run right below the machines, from the column of their first producer to that of their last consumer; the other
+// producers join them with compact mergers and the consumers take items off with compact splitters, the last one
+// taking the end of the lane. Lanes share a row where they don't overlap and columns tunnel under the lanes they cross.
+// The exits go on up to row 0, where their items leave the factory.
+class FactoryBus
+{
+public:
+   static const int LANE_ROW0 = 4;    // rows 0-3 are the machines with their turns, trash and signals
+   static const int LANE_SPACING = 3; // a lane and the rows of the tunnels under it
+
+   struct Lane
+   {
+      std::vector<int> producers; // columns that come down to it
+      std::vector<int> consumers; // columns that go up from it
+   };
+
+   static int laneY( int row ) { return LANE_ROW0 + row*LANE_SPACING; }
+
+   // the machine of `op` at (x,2), making `code` if it's a producer, its output turned right along row 0 to the column
+   // right of it; with `otherHalf` a cutter's second output isn't trashed but turned right along row 1 to that column,
+   // and the output goes one further. Returns the column of each output slot.
+   static std::vector<int> addMachine( BluePrint& ret, Op op, const std::string& code, int x, bool otherHalf = false )
+   {
+      const OpInfo& info = opInfo( op );
+      int width = buildingSize( info.building ).x;
+      int slot = info.outputSlot;
+      ret.add( std::shared_ptr<Building>( new Building( info.building, XY(x,2), 0 ) ) );
+      if ( op == RAW )
+         ret.add( std::shared_ptr<Building>( new ConstantShapeSignal( shapeFromCode( code ), code, XY(x,3), 0 ) ) );
+      if ( otherHalf )
+      {
+         if ( info.building != CUTTER )
+            throw 777;
+         ret.add( std::shared_ptr<Building>( new Building( BELT_RIGHT, XY(x+1,1), 0 ) ) );
+         ret.add( std::shared_ptr<Building>( new Building( BELT_RIGHT, XY(x+2,1), 1 ) ) );
+         ret.add( std::shared_ptr<Building>( new Building( BELT, XY(x,1), 0 ) ) );
+         ret.add( std::shared_ptr<Building>( new Building( BELT_RIGHT, XY(x,0), 0 ) ) );
+         ret.add( std::shared_ptr<Building>( new Building( BELT, XY(x+1,0), 1 ) ) );
+         ret.add( std::shared_ptr<Building>( new Building( BELT, XY(x+2,0), 1 ) ) );
+         ret.add( std::shared_ptr<Building>( new Building( BELT_RIGHT, XY(x+3,0), 1 ) ) );
+         ret.add( std::shared_ptr<Building>( new Building( BELT, XY(x+3,1), 2 ) ) );
+         return { x+3, x+2 }; // (the left tile's output goes along row 0, round the right one's)
+      }
+      if ( info.kind == CUT_OP )
+         for ( int k = 0; k < width; k++ )
+            if ( k != slot )
+               ret.add( std::shared_ptr<Building>( new Building( TRASH, XY(x+k,1), 0 ) ) );
+      ret.add( std::shared_ptr<Building>( new Building( BELT, XY(x+slot,1), 0 ) ) );
+      ret.add( std::shared_ptr<Building>( new Building( BELT_RIGHT, XY(x+slot,0), 0 ) ) );
+      for ( int k = slot+1; k < width; k++ )
+         ret.add( std::shared_ptr<Building>( new Building( BELT, XY(x+k,0), 1 ) ) );
+      ret.add( std::shared_ptr<Building>( new Building( BELT_RIGHT, XY(x+width,0), 1 ) ) );
+      ret.add( std::shared_ptr<Building>( new Building( BELT, XY(x+width,1), 2 ) ) );
+      std::vector<int> columns( width, -1 );
+      columns[slot] = x + width;
+      return columns;
+   }
+
+   // the lanes with their columns; `exits` are the consumer columns that go on up to row 0
+   static void addLanes( BluePrint& ret, std::vector<Lane> lanes, const std::set<int>& exits )
+   {
+      std::stable_sort( lanes.begin(), lanes.end(), []( const Lane& a, const Lane& b ) { return a.producers.front() < b.producers.front(); } );
+      std::vector<int> rowEnds;
+      for ( const Lane& lane : lanes )
+      {
+         int x0 = lane.producers.front();
+         int x1 = lane.consumers.back();
+         int row = 0;
+         while ( row < (int) rowEnds.size() && rowEnds[row] >= x0 )
+            row++;
+         if ( row == (int) rowEnds.size() )
+            rowEnds.push_back( x1 );
+         rowEnds[row] = x1;
+
+         for ( int column : lane.producers )
+            addColumn( ret, column, 2, row, true );
+         for ( int column : lane.consumers )
+            addColumn( ret, column, exits.count( column ) ? 0 : 3, row, false );
+
+         std::set<int> merges( lane.producers.begin() + 1, lane.producers.end() );
+         std::set<int> splits( lane.consumers.begin(), lane.consumers.end() - 1 );
+         ret.add( std::shared_ptr<Building>( new Building( BELT_LEFT, XY(x0,laneY( row )), 2 ) ) );
+         for ( int lx = x0+1; lx < x1; lx++ )
+         {
+            BuildingType type = merges.count( lx ) ? MERGER_LEFT : splits.count( lx ) ? SPLITTER_LEFT : BELT;
+            ret.add( std::shared_ptr<Building>( new Building( type, XY(lx,laneY( row )), 1 ) ) );
+         }
+         ret.add( std::shared_ptr<Building>( new Building( BELT_LEFT, XY(x1,laneY( row )), 1 ) ) );
+      }
+   }
+
+   // the belts of a column between row `top` and the lane in lane row `row` (excluded), down or up,
+   // with a tunnel under each lane row in between
+   static void addColumn( BluePrint& ret, int x, int top, int row, bool down )
+   {
+      for ( int y = top; y < laneY( row ); y++ )
+      {
+         BuildingType type = BELT;
+         bool underLane = false;
+         for ( int r = 0; r < row; r++ )
+         {
+            underLane |= y == laneY( r );
+            if ( y == laneY( r ) + (down ? -1 : 1) ) type = TUNNEL_IN;
+            if ( y == laneY( r ) + (down ? 1 : -1) ) type = TUNNEL_OUT;
+         }
+         if ( !underLane )
+            ret.add( std::shared_ptr<Building>( new Building( type, XY(x,y), down ? 2 : 0 ) ) );
+      }
+   }
+};
+
+// a target of a ThroughputPlanner
+struct TargetRate
+{
+   std::string code;
+   double rate = 1; // items/s
+};
+
+// a node of a ThroughputPlanner's recipe trees, made on one line of machines for everything that uses it
+struct PlanLine
+{
+   std::string code;         // colored as in the targets it ends up in
+   uint16_t shape = 0;
+   Op op = NONE;
+   int a = -1;          // input lines (-1 if none)
+   int b = -1;
+   int numUses = 0;     // inputs of other lines, and targets
+   double demand = 0;   // items/s over all uses
+   int numMachines = 0; // producers for RAW
+   double headroom = 1; // on the demand of its uses, raised where the simulation found it holding a target back
+
+   std::vector<double> laneDemands; // the belts that take its items to its uses, items/s on each
+   std::vector<int> laneOfMachine;  // the lane each machine puts its output on
+   std::vector<int> aLanes;         // for each machine, the lane of line a (and b) it takes its input from
+   std::vector<int> bLanes;
+};
+
+// Lays out factories that make targets at their rates. Each node of a recipe tree, its (code, mapping), which
+// codeForShape turns into the colored code of what it makes, is a line of machines; with `shareLines`, nodes with
+// the same colored code are one line, also across targets (see MultiTargetPlanner). Working down from the targets,
+// the uses of each line are packed onto as few belts (lanes) as carry them, first fit decreasing, and each lane gets
+// ceil( rate / speed ) machines for what its uses take, as ThroughputCostModel counts them.
+//
+// The blueprint is a FactoryBus with the lines built bottom-up from left to right and the targets leaving right of
+// the machines.
+//
+// Machines that run at exactly their speed, and shared lanes whose first uses take more than their share, can leave
+// a target short. So the blueprint is simulated until its output is steady, and while a target falls short the lines
+// it needs that are shared or whose machines were busy all the time are planned for more than their demand.
+class ThroughputPlanner
+{
+public:
+   static const int MEASURE_SECONDS = 600;   // of the full plan, once FactorySimulator::runUntilSteady filled it
+   static const int MAX_ROUNDS = 8;          // of simulating and adding headroom
+   static const int SATURATED_PERCENT = 95;  // of the time busy, for a machine that can't keep up
+   static constexpr double HEADROOM_STEP = 0.25;
+
+   ThroughputPlanner( const Recipes& recipes, const std::vector<TargetRate>& targets, const BuildingSpeeds& speeds = BuildingSpeeds(), bool shareLines = false )
+      : _Targets( targets ), _Speeds( speeds ), _ShareLines( shareLines )
+   {
+      for ( const TargetRate& target : targets )
+      {
+         int root = addLine( recipes, shapeFromCode( target.code ), target.code, Mapping::identity() );
+         _Lines[root].numUses++;
+         _Roots.push_back( root );
+      }
+
+      for ( int round = 0; ; round++ )
+      {
+         sizeLines();
+         std::vector<std::vector<int>> machinesOfLine;
+         _BluePrint = layOut( machinesOfLine );
+         if ( !simulate( machinesOfLine ) || round == MAX_ROUNDS )
+            break;
+      }
+   }
+
+   std::string str() const
+   {
+      std::stringstream ss;
+      for ( int i = 0; i < (int) _Lines.size(); i++ )
+      {
+         const PlanLine& line = _Lines[i];
+         ss << "#" << i << " " << line.code << " " << opStr( line.op );
+         if ( line.a >= 0 ) ss << " #" << line.a;
+         if ( line.b >= 0 ) ss << " #" << line.b;
+         ss << ": " << line.demand << " items/s, " << line.numMachines << "x on " << line.laneDemands.size() << " lanes, used "
+            << line.numUses << "x" << std::endl;
+      }
+      for ( int t = 0; t < (int) _Targets.size(); t++ )
+         ss << _Targets[t].code << ": " << _ItemsPerSecond[t] << " of " << _Targets[t].rate << " items/s" << std::endl;
+      return ss.str();
+   }
+
+private:
+   // an input of a machine (of line `line`, slot 0 for a and 1 for b), or an exit of target `index` if `line` is -1
+   struct Use
+   {
+      double rate;
+      int line;
+      int index;
+      int slot;
+   };
+
+   int addLine( const Recipes& recipes, const Shape& shape, const std::string& finalTarget, const Mapping& mapping )
+   {
+      if ( !recipes.isPossible( shape.code() ) )
+         throw 777;
+      std::string code = codeForShape( shape, finalTarget, mapping );
+      auto it = _LineFor.find( code );
+      if ( it != _LineFor.end() && _ShareLines )
+         return it->second;
+
+      const Recipe& recipe = recipes[shape.code()];
+      PlanLine line;
+      line.code = code;
+      line.shape = shape.code();
+      line.op = recipe.op;
+      if ( recipe.op != RAW ) line.a = addLine( recipes, Shape::fromCode( recipe.a ), finalTarget, mapping * recipe.mappingForA() );
+      if ( recipe.op == STACK ) line.b = addLine( recipes, Shape::fromCode( recipe.b ), finalTarget, mapping * recipe.mappingForB() );
+      if ( line.a >= 0 ) _Lines[line.a].numUses++;
+      if ( line.b >= 0 ) _Lines[line.b].numUses++;
+
+      _Lines.push_back( line );
+      _LineFor[code] = (int) _Lines.size() - 1;
+      return (int) _Lines.size() - 1;
+   }
+
+   // lanes and machines for the demands of the targets, working down from them
+   void sizeLines()
+   {
+      std::vector<std::vector<Use>> uses( _Lines.size() );
+      _ExitLanes.assign( _Targets.size(), std::vector<int>() );
+      for ( int t = 0; t < (int) _Targets.size(); t++ )
+      {
+         int numExits = ThroughputCostModel::machinesNeeded( _Targets[t].rate, _Speeds.belt );
+         _ExitLanes[t].resize( numExits );
+         for ( int i = 0; i < numExits; i++ )
+            uses[_Roots[t]].push_back( Use{ _Targets[t].rate / numExits, -1, t, i } );
+      }
+
+      // lines come after their inputs, so all the uses of a line are known when it is reached
+      for ( int i = (int) _Lines.size() - 1; i >= 0; i-- )
+      {
+         PlanLine& line = _Lines[i];
+         line.demand = 0;
+         line.laneDemands.clear();
+         line.laneOfMachine.clear();
+         for ( Use& use : uses[i] )
+            use.rate *= line.headroom;
+         packLanes( i, uses[i] );
+         double speed = _Speeds.of( opInfo( line.op ).building );
+         for ( int lane = 0; lane < (int) line.laneDemands.size(); lane++ )
+         {
+            int numMachines = ThroughputCostModel::machinesNeeded( line.laneDemands[lane], speed );
+            for ( int k = 0; k < numMachines; k++ )
+            {
+               int machine = (int) line.laneOfMachine.size();
+               line.laneOfMachine.push_back( lane );
+               // (the inputs have headroom of their own, so it doesn't pile up down the tree)
+               double rate = line.laneDemands[lane] / line.headroom / numMachines;
+               if ( line.a >= 0 ) uses[line.a].push_back( Use{ rate, i, machine, 0 } );
+               if ( line.b >= 0 ) uses[line.b].push_back( Use{ rate, i, machine, 1 } );
+            }
+         }
+         line.numMachines = (int) line.laneOfMachine.size();
+         line.aLanes.assign( line.numMachines, -1 );
+         line.bLanes.assign( line.numMachines, -1 );
+      }
+   }
+
+   // runs _BluePrint until it makes its targets at a steady rate and measures them; if some fall short, gives more
+   // headroom to the lines they need that are either shared (the other uses may take more than their share) or busy
+   // all the time, and returns whether there were any
+   bool simulate( const std::vector<std::vector<int>>& machinesOfLine )
+   {
+      // targets with the same code share their items in proportion to their rates
+      std::map<std::string, double> requested;
+      for ( const TargetRate& target : _Targets )
+         requested[target.code] += target.rate;
+
+      std::set<std::string> codes;
+      for ( const auto& code : requested )
+         codes.insert( code.first );
+      FactorySimulator simulator( _BluePrint, _Speeds );
+      simulator.runUntilSteady( codes );
+      std::vector<int> busyBefore;
+      for ( const auto& m : simulator._Machines )
+         busyBefore.push_back( m.busyTicks );
+      SimulationReport report = simulator.run( MEASURE_SECONDS );
+
+      std::vector<bool> feedsShortTarget( _Lines.size(), false );
+      _ItemsPerSecond.clear();
+      for ( int t = 0; t < (int) _Targets.size(); t++ )
+      {
+         int made = report.outputs[_Targets[t].code];
+         _ItemsPerSecond.push_back( made * _Targets[t].rate / requested[_Targets[t].code] / MEASURE_SECONDS );
+         if ( made < requested[_Targets[t].code] * MEASURE_SECONDS - 1 )
+            markInputs( _Roots[t], feedsShortTarget );
+      }
+
+      // (more for the other targets would only let them take more of what they share); if none of them is, the
+      // belts are the bottleneck, and all of them get it
+      std::vector<int> toGrow, needed;
+      for ( int i = 0; i < (int) _Lines.size(); i++ )
+      {
+         if ( !feedsShortTarget[i] )
+            continue;
+         needed.push_back( i );
+         int64_t busyTicks = 0;
+         for ( int machine : machinesOfLine[i] )
+            busyTicks += simulator._Machines[machine].busyTicks - busyBefore[machine];
+         if ( _Lines[i].numUses > 1
+            || busyTicks * 100 >= (int64_t) SATURATED_PERCENT * (int64_t) machinesOfLine[i].size() * MEASURE_SECONDS * FactorySimulator::TICKS_PER_SECOND )
+            toGrow.push_back( i );
+      }
+      for ( int i : toGrow.empty() ? needed : toGrow )
+         _Lines[i].headroom += HEADROOM_STEP;
+      return !needed.empty();
+   }
+
+   void markInputs( int line, std::vector<bool>& marked ) const
+   {
+      if ( marked[line] )
+         return;
+      marked[line] = true;
+      if ( _Lines[line].a >= 0 ) markInputs( _Lines[line].a, marked );
+      if ( _Lines[line].b >= 0 ) markInputs( _Lines[line].b, marked );
+   }
+
+   void packLanes( int line, std::vector<Use>& uses )
+   {
+      std::vector<double>& laneDemands = _Lines[line].laneDemands;
+      std::stable_sort( uses.begin(), uses.end(), []( const Use& a, const Use& b ) { return a.rate > b.rate; } );
+      for ( const Use& use : uses )
+      {
+         int lane = 0;
+         while ( lane < (int) laneDemands.size() && laneDemands[lane] + use.rate > _Speeds.belt + 1e-9 )
+            lane++;
+         if ( lane == (int) laneDemands.size() )
+            laneDemands.push_back( 0 );
+         laneDemands[lane] += use.rate;
+         _Lines[line].demand += use.rate;
+
+         if ( use.line < 0 ) _ExitLanes[use.index][use.slot] = lane;
+         else if ( use.slot == 0 ) _Lines[use.line].aLanes[use.index] = lane;
+         else _Lines[use.line].bLanes[use.index] = lane;
+      }
+   }
+
+   // on a FactoryBus (machinesOfLine: the index of each machine in the blueprint's buildings)
+   BluePrint layOut( std::vector<std::vector<int>>& machinesOfLine ) const
+   {
+      BluePrint ret;
+      std::vector<std::vector<FactoryBus::Lane>> lanes( _Lines.size() );
+      std::set<int> exits;
+      machinesOfLine.assign( _Lines.size(), std::vector<int>() );
+
+      int x = 0;
+      for ( int i = 0; i < (int) _Lines.size(); i++ )
+      {
+         const PlanLine& line = _Lines[i];
+         lanes[i].resize( line.laneDemands.size() );
+         for ( int machine = 0; machine < line.numMachines; machine++ )
+         {
+            machinesOfLine[i].push_back( (int) ret._Buildings.size() );
+            int output = FactoryBus::addMachine( ret, line.op, line.code, x )[opInfo( line.op ).outputSlot];
+            if ( line.a >= 0 ) lanes[line.a][line.aLanes[machine]].consumers.push_back( x );
+            if ( line.b >= 0 ) lanes[line.b][line.bLanes[machine]].consumers.push_back( x+1 );
+            lanes[i][line.laneOfMachine[machine]].producers.push_back( output );
+            x = output + 1;
+         }
+      }
+      for ( int t = 0; t < (int) _Targets.size(); t++ )
+         for ( int lane : _ExitLanes[t] )
+         {
+            lanes[_Roots[t]][lane].consumers.push_back( x );
+            exits.insert( x++ );
+         }
+
+      std::vector<FactoryBus::Lane> allLanes;
+      for ( const std::vector<FactoryBus::Lane>& lanesOfLine : lanes )
+         allLanes.insert( allLanes.end(), lanesOfLine.begin(), lanesOfLine.end() );
+      FactoryBus::addLanes( ret, allLanes, exits );
+      return ret;
+   }
+
+public:
+   std::vector<TargetRate> _Targets;
+   BuildingSpeeds _Speeds;
+   bool _ShareLines;
+   std::vector<PlanLine> _Lines;
+   std::map<std::string, int> _LineFor;
+   std::vector<int> _Roots;                  // line of each target
+   std::vector<std::vector<int>> _ExitLanes; // lanes of its line that each target leaves on
+   BluePrint _BluePrint;
+   std::vector<double> _ItemsPerSecond;      // of each target in the simulated blueprint
+};
+
+// a factory for `rate` items/s of the target: every node of its recipe tree gets ceil( rate / speed ) machines, as
+// ThroughputCostModel counts them (more only if the simulation finds the tree short), taking their inputs off one
+// belt through compact splitters and putting their outputs back onto one belt through compact mergers
+inline BluePrint throughputBluePrintFor( const Recipes& recipes, const std::string& finalTarget, double rate, const BuildingSpeeds& speeds )
+{
+   return ThroughputPlanner( recipes, { { finalTarget, rate } }, speeds )._BluePrint;
+}
+
+// simulates the blueprint of every canonical possible code and checks that it makes the target
+inline void simulateAllRecipes( const Recipes& recipes, int seconds )
+{
+   int numOk = 0;
+   int numWrongShape = 0;
+   int numNoOutput = 0;
+   double minItemsPerSecond = 1e9;
+   std::string slowest;
+   std::map<int, int> bottlenecks; // building type => how often it is the bottleneck
+
+   recipes.possibleShapes().forEach( [&]( int code ) {
+      Shape shape = Shape::fromCode( code );
+      if ( !shape.isCanonical() )
+         return;
+      BluePrint bluePrint = recipes.bluePrintFor( shape, shape.str(), Mapping::identity() );
+      FactorySimulator simulator( bluePrint );
+      SimulationReport report = simulator.run( seconds );
+
+      if ( report.outputs.empty() ) numNoOutput++;
+      else if ( report.outputShape != shape.str() ) numWrongShape++;
+      else numOk++;
+
+      if ( report.bottleneck >= 0 )
+         bottlenecks[bluePrint._Buildings[report.bottleneck]->_Type]++;
+      if ( report.itemsPerSecond < minItemsPerSecond )
+      {
+         minItemsPerSecond = report.itemsPerSecond;
+         slowest = shape.str();
+      }
+   } );
+
+   std::trace << "simulated: ok = " << numOk << " wrong shape = " << numWrongShape << " no output = " << numNoOutput << std::endl;
+   std::trace << "slowest: " << slowest << " at " << minItemsPerSecond << " items/s" << std::endl;
+   for ( const auto& bottleneck : bottlenecks )
+      std::trace << "bottleneck building " << bottleneck.first << ": " << bottleneck.second << " times" << std::endl;
+}
+
+// Recipe trees laid out on a small footprint, instead of Recipes::bluePrintFor's columns side by side.
+// Works bottom-up, once per code. The op's building goes down with its output at (0,0) facing up (a cutter so that the
+// kept part comes out there, trash in front of its other outputs), then each input's layout is put where the result
+// gets the smallest bounding box, then the fewest belts and tunnels: positions are tried in order of the box they
+// would give at best, and the input's output is routed to the building by the cheapest belt, through tunnels where
+// that's shorter. Like Recipes::bluePrintFor's, a layout stays below its output (y >= 0) but for the trash of its
+// cutter, so whatever takes the output can get at it. Producers feed their building directly; constant signals are on
+// the wires layer, so they only have to stay clear of each other. Tunnels never overlap, so an entrance always gets
+// its own exit.
+class CompactLayout
+{
+public:
+   static const int GAP = 2; // the most tiles between an input's layout and the rest, for belts to get through
+
+   explicit CompactLayout( const Recipes& recipes ) : _Recipes( recipes ), _Nodes( 1<<16 ) {}
+
+   BluePrint bluePrintFor( const std::string& finalTarget )
+   {
+      return bluePrintFor( shapeFromCode( finalTarget ), finalTarget, Mapping::identity() );
+   }
+   BluePrint bluePrintFor( const Shape& shape, const std::string& finalTarget, const Mapping& mapping )
+   {
+      BluePrint ret;
+      addBluePrint( ret, shape, finalTarget, mapping, XY(0,0) );
+      return ret;
+   }
+
+private:
+   // the layout of one code: its own buildings, and where its inputs' layouts go
+   struct Node
+   {
+      bool laidOut = false;
+      std::vector<Building> buildings; // the op's building, trash, and the belts and tunnels from the inputs
+      XY inputPos[2];                  // output tiles of the inputs' layouts
+      std::vector<XY> tiles;           // building layer tiles of the whole tree
+      std::vector<XY> signalTiles;     // wires layer tiles of the whole tree
+      std::vector<Rect> tunnels;       // from entrance to exit, of the whole tree
+      Rect rect = Rect( XY(0,0), XY(0,0) );
+      int numConnectors = 0;           // belts and tunnels of the whole tree
+
+      int area() const { return (rect._Pt1.x - rect._Pt0.x) * (rect._Pt1.y - rect._Pt0.y); }
+      bool isBetterThan( const Node& rhs ) const { return area() != rhs.area() ? area() < rhs.area() : numConnectors < rhs.numConnectors; }
+   };
+
+   // what's taken in a window of tiles while an input is placed
+   class Grid
+   {
+   public:
+      enum { BLOCKED = 1, SIGNAL = 2, TUNNEL = 4 };
+
+      explicit Grid( const Rect& window ) : _Window( window ), _Width( window._Pt1.x - window._Pt0.x ), _Cells( _Width * (window._Pt1.y - window._Pt0.y), 0 ) {}
+
+      bool contains( XY p ) const { return p.x >= _Window._Pt0.x && p.y >= _Window._Pt0.y && p.x < _Window._Pt1.x && p.y < _Window._Pt1.y; }
+      uint8_t at( XY p ) const { return contains( p ) ? _Cells[index( p )] : 0; }
+      int index( XY p ) const { return (p.y - _Window._Pt0.y) * _Width + p.x - _Window._Pt0.x; }
+
+      void mark( const Node& node, XY offset, int delta )
+      {
+         for ( XY p : node.tiles ) _Cells[index( p + offset )] += delta * BLOCKED;
+         for ( XY p : node.signalTiles ) _Cells[index( p + offset )] += delta * SIGNAL;
+         for ( const Rect& tunnel : node.tunnels )
+            for ( int y = tunnel._Pt0.y; y < tunnel._Pt1.y; y++ )
+               for ( int x = tunnel._Pt0.x; x < tunnel._Pt1.x; x++ )
+                  _Cells[index( XY(x,y) + offset )] += delta * TUNNEL;
+      }
+
+      // can `node` go at `offset` without touching anything
+      bool fits( const Node& node, XY offset ) const
+      {
+         for ( XY p : node.tiles ) if ( at( p + offset ) & BLOCKED ) return false;
+         for ( XY p : node.signalTiles ) if ( at( p + offset ) & SIGNAL ) return false;
+         for ( const Rect& tunnel : node.tunnels )
+            for ( int y = tunnel._Pt0.y; y < tunnel._Pt1.y; y++ )
+               for ( int x = tunnel._Pt0.x; x < tunnel._Pt1.x; x++ )
+                  if ( at( XY(x,y) + offset ) & TUNNEL ) return false;
+         return true;
+      }
+
+   public:
+      Rect _Window;
+      int _Width;
+      std::vector<uint8_t> _Cells;
+   };
+
+   static Rect tileRect( XY p ) { return Rect( p, p + XY(1,1) ); }
+   static Rect shifted( const Rect& r, XY offset ) { return Rect( r._Pt0 + offset, r._Pt1 + offset ); }
+   static Rect expanded( const Rect& r, int margin ) { return Rect( r._Pt0 - XY(margin,margin), r._Pt1 + XY(margin,margin) ); }
+   static int distance( XY a, XY b ) { return std::abs( a.x - b.x ) + std::abs( a.y - b.y ); }
+
+   const Node& layOut( uint16_t code )
+   {
+      Node& node = _Nodes[code];
+      if ( node.laidOut )
+         return node;
+
+      const Recipe& recipe = _Recipes[code];
+      const OpInfo& info = opInfo( recipe.op );
+      Node root;
+      std::vector<uint16_t> inputs;
+      std::vector<XY> goals; // the building's input tiles, fed from below
+      if ( recipe.op == RAW )
+      {
+         root.buildings.push_back( Building( info.building, XY(0,0), 0 ) );
+         root.tiles.push_back( XY(0,0) );
+         root.signalTiles.push_back( XY(0,1) );
+      }
+      else
+      {
+         int x0 = info.kind == CUT_OP ? -info.outputSlot : 0;
+         root.buildings.push_back( Building( info.building, XY(x0,0), 0 ) );
+         for ( int x = x0; x < x0 + buildingSize( info.building ).x; x++ )
+         {
+            root.tiles.push_back( XY(x,0) );
+            if ( info.kind == CUT_OP && x != 0 )
+            {
+               root.buildings.push_back( Building( TRASH, XY(x,-1), 0 ) );
+               root.tiles.push_back( XY(x,-1) );
+            }
+         }
+         inputs.push_back( recipe.a );
+         goals.push_back( XY(x0,0) );
+         if ( recipe.op == STACK )
+         {
+            inputs.push_back( recipe.b );
+            goals.push_back( XY(1,0) );
+         }
+      }
+      for ( XY p : root.tiles )
+         root.rect = root.rect | tileRect( p );
+      for ( XY p : root.signalTiles )
+         root.rect = root.rect | tileRect( p );
+
+      for ( uint16_t input : inputs )
+         layOut( input );
+      // the first input only gets a few tries, each with a full search for the next one, unless none of them works out
+      Node best;
+      place( root, inputs, goals, 0, best, 3 );
+      if ( !best.laidOut )
+         place( root, inputs, goals, 0, best, 0 );
+      if ( !best.laidOut )
+         throw 777;
+      node = best;
+      return node;
+   }
+
+   // places inputs[i..] onto `state`, keeping the best result in `best` (laidOut once there is one); each input but the
+   // last gets `maxTries` positions that work (0: all of them)
+   void place( const Node& state, const std::vector<uint16_t>& inputs, const std::vector<XY>& goals, int i, Node& best, int maxTries )
+   {
+      if ( i == (int) inputs.size() )
+      {
+         if ( !best.laidOut || state.isBetterThan( best ) )
+         {
+            best = state;
+            best.laidOut = true;
+         }
+         return;
+      }
+
+      // positions that put the input's box at most GAP tiles from the box so far, by the box they give and the distance to go
+      struct Candidate
+      {
+         XY pos;
+         int area;
+         int distance;
+      };
+      const Node& input = _Nodes[inputs[i]];
+      const Rect& box = state.rect;
+      const Rect& r = input.rect;
+      std::vector<Candidate> candidates;
+      for ( int y = std::max( { box._Pt0.y - r._Pt1.y - GAP, -r._Pt0.y, 1 } ); y <= box._Pt1.y - r._Pt0.y + GAP; y++ )
+         for ( int x = box._Pt0.x - r._Pt1.x - GAP; x <= box._Pt1.x - r._Pt0.x + GAP; x++ )
+         {
+            Rect both = box | shifted( r, XY(x,y) );
+            candidates.push_back( { XY(x,y), (both._Pt1.x - both._Pt0.x) * (both._Pt1.y - both._Pt0.y), distance( XY(x,y-1), goals[i] ) } );
+         }
+      std::sort( candidates.begin(), candidates.end(), []( const Candidate& lhs, const Candidate& rhs ) {
+         return lhs.area != rhs.area ? lhs.area < rhs.area : lhs.distance < rhs.distance;
+      } );
+
+      Grid grid( expanded( box, std::max( r._Pt1.x - r._Pt0.x, r._Pt1.y - r._Pt0.y ) + GAP + 1 ) );
+      grid.mark( state, XY(0,0), 1 );
+      grid._Cells[grid.index( XY(0,-1) )] |= Grid::BLOCKED; // where this layout's output goes
+
+      bool isLast = i + 1 == (int) inputs.size();
+      int numPlaced = 0;
+      for ( const Candidate& candidate : candidates )
+      {
+         if ( best.laidOut && candidate.area > best.area() )
+            break;
+         // (a tunnel goes 3 tiles per building)
+         int maxRouteCost = IMPOSSIBLE_COST;
+         if ( isLast && best.laidOut && candidate.area == best.area() )
+            maxRouteCost = best.numConnectors - state.numConnectors - input.numConnectors - 1;
+         if ( (candidate.distance + 2) / 3 > maxRouteCost )
+            break;
+         if ( !grid.fits( input, candidate.pos ) )
+            continue;
+
+         grid.mark( input, candidate.pos, 1 );
+         Node next = state;
+         Rect window = expanded( box | shifted( r, candidate.pos ), 1 );
+         window._Pt0.y = 0;
+         bool routed = route( grid, window, candidate.pos + XY(0,-1), goals[i], maxRouteCost, next );
+         grid.mark( input, candidate.pos, -1 );
+         if ( !routed )
+            continue;
+
+         next.inputPos[i] = candidate.pos;
+         for ( XY p : input.tiles ) next.tiles.push_back( p + candidate.pos );
+         for ( XY p : input.signalTiles ) next.signalTiles.push_back( p + candidate.pos );
+         for ( const Rect& tunnel : input.tunnels ) next.tunnels.push_back( shifted( tunnel, candidate.pos ) );
+         next.rect = next.rect | shifted( r, candidate.pos );
+         next.numConnectors += input.numConnectors;
+         place( next, inputs, goals, i + 1, best, maxTries );
+         if ( !isLast && ++numPlaced == maxTries )
+            break;
+      }
+   }
+
+   // cheapest belt from `start` (entered going up) into `goal` (entered going up), within `window` and of at most
+   // `maxCost` buildings (a tunnel is two); adds its buildings to `node`
+   bool route( const Grid& grid, const Rect& window, XY start, XY goal, int maxCost, Node& node ) const
+   {
+      if ( start == goal )
+         return true;
+      Grid local( window );
+      if ( !local.contains( start ) || (grid.at( start ) & Grid::BLOCKED) || (grid.at( goal + XY(0,1) ) & Grid::BLOCKED) )
+         return false;
+
+      // state: a tile and the direction the item enters it in; moves: a belt (straight or turning) or a tunnel
+      struct Step
+      {
+         int cost = IMPOSSIBLE_COST;
+         int from = -1;
+         int tunnelLength = 0;
+      };
+      auto stateOf = [&]( XY p, int d ) { return local.index( p ) * 4 + d; };
+      auto tileOf = [&]( int s ) { return XY( window._Pt0.x + (s/4) % local._Width, window._Pt0.y + (s/4) / local._Width ); };
+      auto isFree = [&]( XY p ) { return local.contains( p ) && !(grid.at( p ) & Grid::BLOCKED); };
+      std::vector<Step> steps( local._Cells.size() * 4 );
+      std::vector<std::vector<int>> q( 1, std::vector<int>( 1, stateOf( start, 0 ) ) ); // states by cost
+      steps[stateOf( start, 0 )].cost = 0;
+      int goalCost = IMPOSSIBLE_COST, goalFrom = -1, goalTunnelLength = 0;
+      auto reach = [&]( int s, XY p, int d, int cost, int tunnelLength ) {
+         if ( p == goal )
+         {
+            if ( d == 0 && cost < goalCost && cost <= maxCost )
+            {
+               goalCost = cost;
+               goalFrom = s;
+               goalTunnelLength = tunnelLength;
+            }
+            return;
+         }
+         if ( cost > maxCost || !isFree( p ) || cost >= steps[stateOf( p, d )].cost )
+            return;
+         steps[stateOf( p, d )] = { cost, s, tunnelLength };
+         if ( cost >= (int) q.size() )
+            q.resize( cost + 1 );
+         q[cost].push_back( stateOf( p, d ) );
+      };
+      for ( int cost = 0; cost < (int) q.size() && cost + 1 < goalCost; cost++ )
+      {
+         for ( size_t j = 0; j < q[cost].size(); j++ )
+         {
+            int s = q[cost][j];
+            if ( cost > steps[s].cost )
+               continue;
+            XY p = tileOf( s );
+            int d = s & 3;
+            for ( int turn : { 0, 1, 3 } )
+               reach( s, p + FactorySimulator::dir( d + turn ), (d + turn) & 3, cost + 1, 0 );
+            for ( int k = 2; k <= FactorySimulator::TUNNEL_RANGE; k++ )
+            {
+               XY exit = p + FactorySimulator::dir( d ) * k;
+               if ( !isFree( exit ) )
+                  continue;
+               bool clear = true;
+               for ( int i = 0; i <= k && clear; i++ )
+                  clear = !(grid.at( p + FactorySimulator::dir( d ) * i ) & Grid::TUNNEL);
+               if ( clear )
+                  reach( s, exit + FactorySimulator::dir( d ), d, cost + 2, k );
+            }
+         }
+      }
+      if ( goalFrom < 0 )
+         return false;
+
+      // back from the goal; the buildings must not cross themselves or their own tunnels
+      std::vector<Building> buildings;
+      std::vector<Rect> tunnels;
+      int dOut = 0;
+      for ( int s = goalFrom, tunnelLength = goalTunnelLength; s >= 0; tunnelLength = steps[s].tunnelLength, s = steps[s].from )
+      {
+         XY p = tileOf( s );
+         int d = s & 3;
+         if ( tunnelLength )
+         {
+            XY exit = p + FactorySimulator::dir( d ) * tunnelLength;
+            buildings.push_back( Building( TUNNEL_OUT, exit, d ) );
+            buildings.push_back( Building( TUNNEL_IN, p, d ) );
+            tunnels.push_back( tileRect( p ) | tileRect( exit ) );
+         }
+         else
+            buildings.push_back( Building( dOut == d ? BELT : dOut == ((d+1)&3) ? BELT_RIGHT : BELT_LEFT, p, d ) );
+         dOut = d;
+      }
+      std::set<XY> tiles;
+      for ( const Building& building : buildings )
+         if ( !tiles.insert( building._Pos ).second )
+            return false;
+      for ( int j = 0; j < (int) tunnels.size(); j++ )
+         for ( int k = j + 1; k < (int) tunnels.size(); k++ )
+            if ( intersects( tunnels[j], tunnels[k] ) )
+               return false;
+
+      for ( const Building& building : buildings )
+      {
+         node.buildings.push_back( building );
+         node.tiles.push_back( building._Pos );
+         node.rect = node.rect | tileRect( building._Pos );
+      }
+      node.tunnels.insert( node.tunnels.end(), tunnels.begin(), tunnels.end() );
+      node.numConnectors += (int) buildings.size();
+      return true;
+   }
+
+   static bool intersects( const Rect& a, const Rect& b )
+   {
+      return a._Pt0.x < b._Pt1.x && b._Pt0.x < a._Pt1.x && a._Pt0.y < b._Pt1.y && b._Pt0.y < a._Pt1.y;
+   }
+
+   void addBluePrint( BluePrint& bluePrint, const Shape& shape, const std::string& finalTarget, const Mapping& mapping, XY offset )
+   {
+      const Node& node = layOut( shape.code() );
+      const Recipe& recipe = _Recipes[shape.code()];
+      for ( const Building& building : node.buildings )
+         bluePrint.add( building.clone( offset ) );
+      if ( recipe.op == RAW )
+         bluePrint.add( std::shared_ptr<Building>( new ConstantShapeSignal( shape, codeForShape( shape, finalTarget, mapping ), offset + XY(0,1), 0 ) ) );
+      else
+         addBluePrint( bluePrint, Shape::fromCode( recipe.a ), finalTarget, mapping * recipe.mappingForA(), offset + node.inputPos[0] );
+      if ( recipe.op == STACK )
+         addBluePrint( bluePrint, Shape::fromCode( recipe.b ), finalTarget, mapping * recipe.mappingForB(), offset + node.inputPos[1] );
+   }
+
+public:
+   const Recipes& _Recipes;
+   std::vector<Node> _Nodes; // by code, laid out when first needed
+};
+
+// CompactLayout against Recipes::bluePrintFor over every canonical possible code: footprints, buildings and belts in
+// total, and with `simulateSeconds`, whether each compact blueprint still makes its shape and nothing else
+inline void traceCompactLayoutSavings( const Recipes& recipes, int simulateSeconds = 0 )
+{
+   enum { AREA_, BUILDINGS_, BELTS_, TUNNELS_, NUM_COUNTS };
+   long long counts[2][NUM_COUNTS] = {};
+   int numSmaller = 0, numLarger = 0, numShapes = 0;
+   int numOk = 0, numWrong = 0;
+   CompactLayout compact( recipes );
+
+   recipes.possibleShapes().forEach( [&]( int code ) {
+      Shape shape = Shape::fromCode( code );
+      if ( !shape.isCanonical() )
+         return;
+      BluePrint bluePrints[2] = { recipes.bluePrintFor( shape, shape.str(), Mapping::identity() ), compact.bluePrintFor( shape, shape.str(), Mapping::identity() ) };
+      int area[2];
+      for ( int i = 0; i < 2; i++ )
+      {
+         XY size = bluePrints[i].rect().size();
+         area[i] = size.x * size.y;
+         counts[i][AREA_] += area[i];
+         counts[i][BUILDINGS_] += bluePrints[i]._Buildings.size();
+         for ( const std::shared_ptr<Building>& building : bluePrints[i]._Buildings )
+         {
+            counts[i][BELTS_] += building->_Type == BELT || building->_Type == BELT_LEFT || building->_Type == BELT_RIGHT;
+            counts[i][TUNNELS_] += building->_Type == TUNNEL_IN || building->_Type == TUNNEL_OUT;
+         }
+      }
+      numSmaller += area[1] < area[0];
+      numLarger += area[1] > area[0];
+      numShapes++;
+
+      if ( simulateSeconds )
+      {
+         SimulationReport report = FactorySimulator( bluePrints[1] ).run( simulateSeconds );
+         if ( report.error.empty() && report.outputs.size() == 1 && report.outputShape == shape.str() ) numOk++;
+         else numWrong++;
+      }
+   } );
+
+   auto percent = [&]( int count ) { return counts[0][count] ? 100.0 * (counts[0][count] - counts[1][count]) / counts[0][count] : 0.0; };
+   std::trace << "compact layout of " << numShapes << " shapes: " << numSmaller << " smaller, " << numLarger << " larger" << std::endl;
+   std::trace << "area " << counts[0][AREA_] << " => " << counts[1][AREA_] << " (-" << percent( AREA_ ) << "%)" << std::endl;
+   std::trace << "buildings " << counts[0][BUILDINGS_] << " => " << counts[1][BUILDINGS_] << " (-" << percent( BUILDINGS_ ) << "%)" << std::endl;
+   std::trace << "belts " << counts[0][BELTS_] << " => " << counts[1][BELTS_] << " (-" << percent( BELTS_ ) << "%), tunnels " << counts[1][TUNNELS_] << std::endl;
+   if ( simulateSeconds )
+      std::trace << "simulated: ok = " << numOk << " wrong = " << numWrong << std::endl;
+}
+
+// one operation of a recipe tree, as planned by ByproductPlanner
+struct PlanNode
+{
+   uint16_t code = 0;    // what the node makes
+   ColoredShape colors;  // the same, colored as in its target; "??" where it is cut off later and no color is needed
+   Op op = NONE;
+   int target = 0;       // index of the target whose tree the node is in
+   int a = -1;           // input nodes (-1 if none)
+   int b = -1;
+   int fedBy = -1;       // cut whose discarded half is used instead of this node's subtree
+   int fedRotation = 0;  // quarter turns of the rotator between that half and this node
+   int feeds = -1;       // (for cuts) node that the discarded half goes to instead of the trash
+   bool removed = false; // in a subtree that is replaced by a discarded half
+
+   int numProducers = 0; // in the subtree of the node, itself included
+   int numCutters = 0;
+   int numStackers = 0;
+   int numRotators = 0;
+   int numMachines() const { return numCutters + numStackers + numRotators; }
+};
+
+struct ByproductReport
+{
+   int numRoutedHalves = 0; // i.e. trash buildings saved
+   int numProducersSaved = 0;
+   int numCuttersSaved = 0;
+   int numStackersSaved = 0;
+   int numRotatorsSaved = 0;
+   int numMachinesSaved() const { return numCuttersSaved + numStackersSaved + numRotatorsSaved; }
+
+   std::vector<double> itemsPerSecond; // of each target in the simulated blueprint
+   int numOtherItems = 0;              // that left it but aren't a target
+};
+
+// Plans the recipe trees of a batch of targets so that the half a cut would trash is routed to a node that needs
+// that shape (or a rotation of it, through one rotator), in the same tree or another target's, and that node's
+// subtree isn't built. Needs are matched greedily, biggest subtree first. The half has to have the node's colors
+// where both have them; where only the node has them, the producers below the cut are colored for it (that part of
+// their shape was trashed, so no color was asked of it).
+//
+// The plan is laid out on a FactoryBus, one machine per node that is still built and a rotator where a half needs
+// one, each output on a lane of its own and the targets leaving right of the machines, and simulated until steady.
+class ByproductPlanner
+{
+public:
+   static const int MEASURE_SECONDS = 600; // once FactorySimulator::runUntilSteady filled it
+
+   ByproductPlanner( const Recipes& recipes, const std::vector<std::string>& targets, const BuildingSpeeds& speeds = BuildingSpeeds() )
+      : _Targets( targets )
+   {
+      for ( int i = 0; i < (int) targets.size(); i++ )
+         _Roots.push_back( addTree( recipes, shapeFromCode( targets[i] ).code(), i, Mapping::identity() ) );
+
+      std::vector<int> needs;
+      for ( int i = 0; i < (int) _Nodes.size(); i++ )
+         needs.push_back( i );
+      std::stable_sort( needs.begin(), needs.end(), [&]( int a, int b ) {
+         return _Nodes[a].numProducers + _Nodes[a].numMachines() > _Nodes[b].numProducers + _Nodes[b].numMachines(); } );
+
+      for ( int need : needs )
+      {
+         if ( _Nodes[need].removed || hasRoutedCut( need ) )
+            continue;
+         // a rotator only pays off if it replaces more than one building
+         int maxRotation = _Nodes[need].numProducers + _Nodes[need].numMachines() > 1 ? 3 : 0;
+         for ( int rotation = 0; rotation <= maxRotation; rotation++ )
+         {
+            int cut = findCut( need, rotation );
+            if ( cut >= 0 )
+            {
+               route( cut, need, rotation );
+               break;
+            }
+         }
+      }
+
+      _BluePrint = layOut();
+      FactorySimulator simulator( _BluePrint, speeds );
+      simulator.runUntilSteady( std::set<std::string>( targets.begin(), targets.end() ) );
+      std::map<std::string, int> outputs = simulator.run( MEASURE_SECONDS ).outputs;
+      for ( const std::string& target : targets )
+         _Report.itemsPerSecond.push_back( outputs[target] / (double) std::count( targets.begin(), targets.end(), target ) / MEASURE_SECONDS );
+      for ( const auto& output : outputs )
+         if ( std::find( targets.begin(), targets.end(), output.first ) == targets.end() )
+            _Report.numOtherItems += output.second;
+   }
+
+   // code of the half that `node` trashes, 0 if it isn't a cut in two
+   uint16_t discardedHalf( int node ) const
+   {
+      const PlanNode& n = _Nodes[node];
+      if ( opInfo( n.op ).building != CUTTER )
+         return 0;
+      return Shape::fromCode( _Nodes[n.a].code ).cut( 15 & ~opInfo( n.op ).keptQuadrants ).code();
+   }
+
+   // the colored code a producer of `node` is set to, or that it makes
+   std::string codeOf( int node ) const
+   {
+      ColoredShape ret = _Nodes[node].colors;
+      for ( int i = 0; i < 16; i++ )
+         if ( isFree( ret, i ) )
+            std::copy( "Cu", "Cu"+2, ret.parts[i] );
+      return ret.code();
+   }
+
+   std::string str() const
+   {
+      std::stringstream ss;
+      for ( int i = 0; i < (int) _Roots.size(); i++ )
+         ss << str( _Roots[i], "" );
+      ss << "routed halves = " << _Report.numRoutedHalves << " producers saved = " << _Report.numProducersSaved
+         << " machines saved = " << _Report.numMachinesSaved() << " (cutters " << _Report.numCuttersSaved
+         << ", stackers " << _Report.numStackersSaved << ", rotators " << _Report.numRotatorsSaved << ")" << std::endl;
+      for ( int t = 0; t < (int) _Targets.size(); t++ )
+         ss << _Targets[t] << ": " << _Report.itemsPerSecond[t] << " items/s" << std::endl;
+      if ( _Report.numOtherItems )
+         ss << _Report.numOtherItems << " other items left the factory" << std::endl;
+      return ss.str();
+   }
+
+private:
+   int addTree( const Recipes& recipes, uint16_t code, int target, const Mapping& mapping )
+   {
+      const Recipe& recipe = recipes[code];
+      if ( !recipes.isPossible( code ) )
+         throw 777;
+
+      PlanNode node;
+      node.code = code;
+      ColoredShape targetColors = ColoredShape::fromCode( _Targets[target] );
+      for ( int i = 0; i < 16; i++ )
+         if ( Shape::fromCode( code ).layers[i/4].b & (1 << (i&3)) )
+         {
+            const char* color = mapping[i] >= 0 ? targetColors.parts[mapping[i]] : "??";
+            std::copy( color, color+2, node.colors.parts[i] );
+         }
+      node.op = recipe.op;
+      node.target = target;
+      if ( recipe.op != RAW ) node.a = addTree( recipes, recipe.a, target, mapping * recipe.mappingForA() );
+      if ( recipe.op == STACK ) node.b = addTree( recipes, recipe.b, target, mapping * recipe.mappingForB() );
+
+      node.numProducers = recipe.op == RAW;
+      node.numCutters = opInfo( recipe.op ).kind == CUT_OP;
+      node.numStackers = recipe.op == STACK;
+      node.numRotators = opInfo( recipe.op ).kind == ROTATE_OP;
+      for ( int input : { node.a, node.b } )
+      {
+         if ( input < 0 )
+            continue;
+         node.numProducers += _Nodes[input].numProducers;
+         node.numCutters += _Nodes[input].numCutters;
+         node.numStackers += _Nodes[input].numStackers;
+         node.numRotators += _Nodes[input].numRotators;
+      }
+      _Nodes.push_back( node );
+      return (int) _Nodes.size() - 1;
+   }
+
+   // what `cut` trashes, turned `rotation` times
+   ColoredShape discardedColors( int cut, int rotation ) const
+   {
+      ColoredShape ret = _Nodes[_Nodes[cut].a].colors.cut( 15 & ~opInfo( _Nodes[cut].op ).keptQuadrants );
+      for ( int i = 0; i < rotation; i++ )
+         ret = ret.rotated();
+      return ret;
+   }
+
+   static bool isFree( const ColoredShape& shape, int i ) { return shape.parts[i][0] == '?'; }
+
+   // a live cut whose trashed half, rotated `rotation` times, is what `need` makes (-1 if none)
+   int findCut( int need, int rotation ) const
+   {
+      for ( int cut = 0; cut < (int) _Nodes.size(); cut++ )
+      {
+         const PlanNode& c = _Nodes[cut];
+         if ( c.removed || c.feeds >= 0 || !discardedHalf( cut ) )
+            continue;
+         ColoredShape half = discardedColors( cut, rotation );
+         const ColoredShape& wanted = _Nodes[need].colors;
+         bool fits = half.shape().code() == _Nodes[need].code;
+         for ( int i = 0; i < 16 && fits; i++ )
+            fits = !half.has( i ) || isFree( half, i ) || isFree( wanted, i ) || std::equal( half.parts[i], half.parts[i]+2, wanted.parts[i] );
+         if ( fits && !dependsOn( cut, need ) )
+            return cut;
+      }
+      return -1;
+   }
+
+   // does `node`'s output need `other`'s, through inputs or routed halves
+   bool dependsOn( int node, int other ) const
+   {
+      if ( node == other )
+         return true;
+      const PlanNode& n = _Nodes[node];
+      if ( n.fedBy >= 0 )
+         return dependsOn( n.fedBy, other );
+      return (n.a >= 0 && dependsOn( n.a, other )) || (n.b >= 0 && dependsOn( n.b, other ));
+   }
+
+   // does a cut in `node`'s subtree already send its half somewhere (then the subtree must stay)
+   bool hasRoutedCut( int node ) const
+   {
+      const PlanNode& n = _Nodes[node];
+      return n.feeds >= 0 || (n.a >= 0 && hasRoutedCut( n.a )) || (n.b >= 0 && hasRoutedCut( n.b ));
+   }
+
+   void remove( int node )
+   {
+      PlanNode& n = _Nodes[node];
+      n.removed = true;
+      if ( n.fedBy >= 0 ) // the half it got is trashed again
+      {
+         if ( n.fedRotation )
+            _Report.numRotatorsSaved++;
+         _Nodes[n.fedBy].feeds = -1;
+         n.fedBy = -1;
+         _Report.numRoutedHalves--;
+         return;
+      }
+      if ( n.a >= 0 ) remove( n.a );
+      if ( n.b >= 0 ) remove( n.b );
+   }
+
+   void route( int cut, int need, int rotation )
+   {
+      addSavings( need );
+      remove( need );
+      if ( rotation )
+         _Report.numRotatorsSaved--;
+      _Nodes[need].fedBy = cut;
+      _Nodes[need].fedRotation = rotation;
+      _Nodes[cut].feeds = need;
+      _Report.numRoutedHalves++;
+
+      ColoredShape wanted = _Nodes[need].colors;
+      for ( int i = 0; i < 16; i++ )
+         if ( wanted.has( i ) && !isFree( wanted, i ) )
+            paint( need, i, wanted.parts[i] );
+      _Nodes[need].colors = discardedColors( cut, rotation );
+   }
+
+   // gives part `i` of what `node` makes the color `color`, and the part of its input (or routed half) it comes from
+   void paint( int node, int i, const char* color )
+   {
+      PlanNode& n = _Nodes[node];
+      std::copy( color, color+2, n.colors.parts[i] );
+      if ( n.fedBy >= 0 )
+      {
+         // back through the rotator, then to where the half was in the cut's input
+         int halfPart = (i&12) | ((i + 4 - n.fedRotation) & 3);
+         const PlanNode& cut = _Nodes[n.fedBy];
+         int discarded = 15 & ~opInfo( cut.op ).keptQuadrants;
+         Op otherCut = cut.op;
+         for ( int op = 0; op < NUM_OPS; op++ )
+            if ( opInfo( (Op) op ).building == CUTTER && opInfo( (Op) op ).keptQuadrants == discarded )
+               otherCut = (Op) op;
+         Mapping mapping = Recipe{ _Nodes[cut.a].code, 0, otherCut }.mappingForA();
+         for ( int k = 0; k < 16; k++ )
+            if ( mapping[k] == halfPart && _Nodes[cut.a].colors.has( k ) && isFree( _Nodes[cut.a].colors, k ) )
+               paint( cut.a, k, color );
+         return;
+      }
+      if ( n.op == RAW )
+         return;
+      Recipe recipe = { _Nodes[n.a].code, n.b >= 0 ? _Nodes[n.b].code : (uint16_t) 0, n.op };
+      for ( int slot = 0; slot < (n.op == STACK ? 2 : 1); slot++ )
+      {
+         int input = slot ? n.b : n.a;
+         Mapping mapping = slot ? recipe.mappingForB() : recipe.mappingForA();
+         for ( int k = 0; k < 16; k++ )
+            if ( mapping[k] == i && _Nodes[input].colors.has( k ) && isFree( _Nodes[input].colors, k ) )
+               paint( input, k, color );
+      }
+   }
+
+   // the buildings of `node`'s subtree that are still built
+   void addSavings( int node )
+   {
+      const PlanNode& n = _Nodes[node];
+      if ( n.fedBy >= 0 )
+         return;
+      _Report.numProducersSaved += n.op == RAW;
+      _Report.numCuttersSaved += opInfo( n.op ).kind == CUT_OP;
+      _Report.numStackersSaved += n.op == STACK;
+      _Report.numRotatorsSaved += opInfo( n.op ).kind == ROTATE_OP;
+      if ( n.a >= 0 ) addSavings( n.a );
+      if ( n.b >= 0 ) addSavings( n.b );
+   }
+
+   // the nodes that are built, each after those it takes items from
+   void addInOrder( int node, std::vector<int>& order, std::vector<bool>& added ) const
+   {
+      if ( added[node] )
+         return;
+      added[node] = true;
+      const PlanNode& n = _Nodes[node];
+      if ( n.fedBy >= 0 )
+         addInOrder( n.fedBy, order, added );
+      else
+      {
+         if ( n.a >= 0 ) addInOrder( n.a, order, added );
+         if ( n.b >= 0 ) addInOrder( n.b, order, added );
+      }
+      order.push_back( node );
+   }
+
+   BluePrint layOut() const
+   {
+      std::vector<int> order;
+      std::vector<bool> added( _Nodes.size(), false );
+      for ( int root : _Roots )
+         addInOrder( root, order, added );
+
+      BluePrint ret;
+      std::vector<FactoryBus::Lane> lanes;
+      std::vector<int> laneOf( _Nodes.size(), -1 ), halfLaneOf( _Nodes.size(), -1 );
+      auto addLane = [&]( int producer ) {
+         lanes.push_back( FactoryBus::Lane() );
+         lanes.back().producers.push_back( producer );
+         return (int) lanes.size() - 1;
+      };
+      int x = 0;
+      for ( int node : order )
+      {
+         const PlanNode& n = _Nodes[node];
+         if ( n.fedBy >= 0 && !n.fedRotation )
+         {
+            laneOf[node] = halfLaneOf[n.fedBy];
+            continue;
+         }
+         Op op = n.fedBy >= 0 ? (Op) (ROTATE_1 + n.fedRotation - 1) : n.op;
+         std::vector<int> columns = FactoryBus::addMachine( ret, op, codeOf( node ), x, n.feeds >= 0 );
+         if ( n.fedBy >= 0 ) lanes[halfLaneOf[n.fedBy]].consumers.push_back( x );
+         else if ( n.a >= 0 ) lanes[laneOf[n.a]].consumers.push_back( x );
+         if ( n.fedBy < 0 && n.b >= 0 ) lanes[laneOf[n.b]].consumers.push_back( x+1 );
+         int slot = opInfo( op ).outputSlot;
+         laneOf[node] = addLane( columns[slot] );
+         if ( n.feeds >= 0 )
+            halfLaneOf[node] = addLane( columns[1-slot] );
+         x = *std::max_element( columns.begin(), columns.end() ) + 1;
+      }
+
+      std::set<int> exits;
+      for ( int root : _Roots )
+      {
+         lanes[laneOf[root]].consumers.push_back( x );
+         exits.insert( x++ );
+      }
+      FactoryBus::addLanes( ret, lanes, exits );
+      return ret;
+   }
+
+   std::string str( int node, const std::string& prefix ) const
+   {
+      std::stringstream ss;
+      const PlanNode& n = _Nodes[node];
+      ss << prefix << "#" << node << " " << codeOf( node ) << " ";
+      if ( n.fedBy >= 0 )
+         ss << "half of #" << n.fedBy << ( n.fedRotation ? " ROTATE_" + std::to_string( n.fedRotation ) : "" ) << std::endl;
+      else
+      {
+         ss << opStr( n.op );
+         if ( n.feeds >= 0 )
+            ss << " (other half to #" << n.feeds << ")";
+         ss << std::endl;
+         if ( n.a >= 0 ) ss << str( n.a, prefix + "  " );
+         if ( n.b >= 0 ) ss << str( n.b, prefix + "  " );
+      }
+      return ss.str();
+   }
+
+public:
+   std::vector<std::string> _Targets;
+   std::vector<PlanNode> _Nodes;
+   std::vector<int> _Roots;
+   BluePrint _BluePrint;
+   ByproductReport _Report;
+};
+
+// recipes for the distinct intermediates of a target, each built once and split to wherever it's used
+struct DagPlan
+{
+   int cost = IMPOSSIBLE_COST;     // every distinct intermediate counted once
+   int treeCost = IMPOSSIBLE_COST; // of the tables' recipe tree
+   bool exhaustive = true;         // false if the search ran out of effort (cost is then the best found)
+   std::map<std::string, Recipe> recipes; // by the colored code of the intermediate
+};
+
+// Branch and bound over the recipes of a target's intermediates, where an intermediate used twice is paid for once.
+// An intermediate is a node of the recipe tree, its (code, mapping), which codeForShape turns into the colored code
+// of what it makes (quadrants that get cut off are made uncolored), so only uses that need the same colors share it.
+// Besides each code's recipe from the tables it tries its rotations, stacks of its layer splits, and cuts and stacks
+// that reuse an intermediate already in the plan. All inputs of a candidate come before the code in the order
+// ( tree cost, Recipes::bottomUpOrder ), so the plan is acyclic, and intermediates are decided in reverse of that
+// order, i.e. after all their users. Starts from the tables' tree with its repeats merged, which is also the fallback.
+class DagCostSearch
+{
+public:
+   // `ops` restricts the alternatives tried; the tables' own recipes are taken as they are
+   DagCostSearch( const Recipes& recipes, int rotateCost, int cutCost, int stackCost, int maxExpansions = 20000, OpMask ops = CLASSIC_OPS )
+      : _Recipes( recipes ), _RotateCost( rotateCost ), _CutCost( cutCost ), _StackCost( stackCost ), _MaxExpansions( maxExpansions ), _Ops( ops )
+   {
+      _Costs = recipes.costs( rotateCost, cutCost, stackCost );
+      std::vector<uint16_t> order = recipes.bottomUpOrder();
+      std::stable_sort( order.begin(), order.end(), [&]( uint16_t a, uint16_t b ) { return _Costs[a] < _Costs[b]; } );
+      _Rank.resize( 1<<16, -1 );
+      for ( int i = 0; i < (int) order.size(); i++ )
+         _Rank[order[i]] = i;
+   }
+
+   DagPlan search( const std::string& finalTarget )
+   {
+      uint16_t code = shapeFromCode( finalTarget ).code();
+      if ( !_Recipes.isPossible( code ) )
+         throw 777;
+
+      _FinalTarget = finalTarget;
+      _Best = DagPlan();
+      _Best.treeCost = _Costs[code];
+      _Best.cost = 0;
+      addTablesTree( code, Mapping::identity(), _Best );
+
+      _NumExpansions = 0;
+      _Pending.insert( { keyFor( code, Mapping::identity() ), Mapping::identity() } );
+      expand( 0 );
+      _Pending.clear();
+      _Chosen.clear();
+      return _Best;
+   }
+
+private:
+   // pending intermediates by ( rank of the code, colored code, code )
+   typedef std::tuple<int, std::string, uint16_t> Key;
+
+   Key keyFor( uint16_t code, const Mapping& mapping ) const
+   {
+      return Key( _Rank[code], codeForShape( Shape::fromCode( code ), _FinalTarget, mapping ), code );
+   }
+
+   void addTablesTree( uint16_t code, const Mapping& mapping, DagPlan& plan ) const
+   {
+      const Recipe& recipe = _Recipes[code];
+      if ( !plan.recipes.insert( { codeForShape( Shape::fromCode( code ), _FinalTarget, mapping ), recipe } ).second )
+         return;
+      plan.cost += opCost( recipe.op, _RotateCost, _CutCost, _StackCost );
+      if ( recipe.op != RAW ) addTablesTree( recipe.a, mapping * recipe.mappingForA(), plan );
+      if ( recipe.op == STACK ) addTablesTree( recipe.b, mapping * recipe.mappingForB(), plan );
+   }
+
+   void expand( int cost )
+   {
+      if ( cost >= _Best.cost )
+         return;
+      if ( _Pending.empty() )
+      {
+         _Best.cost = cost;
+         _Best.recipes = _Chosen;
+         return;
+      }
+      if ( _NumExpansions++ >= _MaxExpansions )
+      {
+         _Best.exhaustive = false;
+         return;
+      }
+
+      std::pair<Key, Mapping> next = *_Pending.rbegin();
+      _Pending.erase( next.first );
+      for ( const Recipe& recipe : candidatesFor( std::get<2>( next.first ), next.second ) )
+      {
+         // inputs come before the code, so they aren't decided yet
+         std::vector<Key> added;
+         if ( recipe.op != RAW )
+            for ( int slot = 0; slot < (recipe.op == STACK ? 2 : 1); slot++ )
+            {
+               Mapping mapping = next.second * (slot ? recipe.mappingForB() : recipe.mappingForA());
+               Key input = keyFor( slot ? recipe.b : recipe.a, mapping );
+               if ( _Pending.insert( { input, mapping } ).second )
+                  added.push_back( input );
+            }
+         _Chosen[std::get<1>( next.first )] = recipe;
+
+         expand( cost + opCost( recipe.op, _RotateCost, _CutCost, _StackCost ) );
+
+         _Chosen.erase( std::get<1>( next.first ) );
+         for ( const Key& input : added )
+            _Pending.erase( input );
+      }
+      _Pending.insert( next );
+   }
+
+   // cheapest first, by the tree cost of the inputs that aren't in the plan yet
+   std::vector<Recipe> candidatesFor( uint16_t code, const Mapping& mapping ) const
+   {
+      std::vector<std::pair<int, Recipe>> candidates;
+      auto add = [&]( uint16_t a, uint16_t b, Op op ) {
+         if ( !(_Ops & opBit( op )) && !(a == _Recipes[code].a && b == _Recipes[code].b && op == _Recipes[code].op) )
+            return;
+         for ( uint16_t input : { a, b } )
+            if ( input && op != RAW && ( !_Recipes.isPossible( input ) || _Rank[input] >= _Rank[code] ) )
+               return;
+         for ( const auto& candidate : candidates )
+            if ( candidate.second.a == a && candidate.second.b == b && candidate.second.op == op )
+               return;
+         Recipe recipe = { a, b, op };
+         int estimate = opCost( op, _RotateCost, _CutCost, _StackCost );
+         if ( op != RAW && !_Pending.count( keyFor( a, mapping * recipe.mappingForA() ) ) )
+            estimate += _Costs[a];
+         if ( op == STACK && !_Pending.count( keyFor( b, mapping * recipe.mappingForB() ) ) )
+            estimate += _Costs[b];
+         candidates.push_back( { estimate, recipe } );
+      };
+
+      const Recipe& recipe = _Recipes[code];
+      add( recipe.a, recipe.b, recipe.op );
+
+      for ( int op = 0; op < NUM_OPS; op++ )
+      {
+         if ( opInfo( (Op) op ).kind != ROTATE_OP )
+            continue;
+         Shape input = Shape::fromCode( code ); // turned the rest of the way round
+         for ( int i = opInfo( (Op) op ).numRotations; i < 4; i++ )
+            input = input.rotated();
+         add( input.code(), 0, (Op) op );
+      }
+
+      for ( int k = 1; k < 4; k++ )
+         addStack( code, code & ((1<<4*k) - 1), code >> 4*k, add );
+
+      // (a pending code only shares its line if the colors it is needed in match, see expand)
+      for ( const auto& pending : _Pending )
+      {
+         uint16_t pendingCode = std::get<2>( pending.first );
+         Shape x = Shape::fromCode( pendingCode );
+         for ( int op = 0; op < NUM_OPS; op++ )
+            if ( opInfo( (Op) op ).kind == CUT_OP && applyOp( (Op) op, x ).code() == code )
+               add( pendingCode, 0, (Op) op );
+
+         // x as the bottom or, at any layer, as the top of a stack giving code
+         uint16_t rest = code & ~pendingCode;
+         if ( rest && (pendingCode & ~code) == 0 )
+         {
+            int k = 0;
+            while ( !((rest >> 4*k) & 15) ) k++;
+            addStack( code, pendingCode, rest >> 4*k, add );
+         }
+         for ( int k = 0; k < 4; k++ )
+         {
+            uint16_t top = (uint16_t) (pendingCode << 4*k);
+            if ( top >> 4*k == pendingCode && (top & ~code) == 0 && (code & ~top) )
+               addStack( code, code & ~top, pendingCode, add );
+         }
+      }
+
+      std::stable_sort( candidates.begin(), candidates.end(), []( const std::pair<int, Recipe>& a, const std::pair<int, Recipe>& b ) { return a.first < b.first; } );
+      std::vector<Recipe> ret;
+      for ( const auto& candidate : candidates )
+         ret.push_back( candidate.second );
+      return ret;
+   }
+
+   template <class F>
+   static void addStack( uint16_t code, uint16_t a, uint16_t b, F& add )
+   {
+      if ( a && b && ::stack( Shape::fromCode( a ), Shape::fromCode( b ) ).code() == code )
+         add( a, b, STACK );
+   }
+
+public:
+   const Recipes& _Recipes;
+   int _RotateCost;
+   int _CutCost;
+   int _StackCost;
+   int _MaxExpansions;
+   OpMask _Ops;
+   std::vector<int> _Costs;
+   std::vector<int> _Rank;
+
+   std::string _FinalTarget;
+   DagPlan _Best;
+   std::map<std::string, Recipe> _Chosen;
+   std::map<Key, Mapping> _Pending;
+   int _NumExpansions = 0;
+};
+
+// how many canonical shapes get cheaper when shared intermediates are paid for once
+inline void traceDagSavings( const Recipes& recipes, int rotateCost, int cutCost, int stackCost, int maxExpansions = 20000 )
+{
+   DagCostSearch search( recipes, rotateCost, cutCost, stackCost, maxExpansions );
+   int numShapes = 0;
+   int numCheaper = 0;
+   int numNotExhaustive = 0;
+   long long totalTreeCost = 0;
+   long long totalCost = 0;
+   std::map<int, int> savings; // cost saved => how many shapes
+   std::string best;
+   int bestSaving = 0;
+
+   recipes.possibleShapes().forEach( [&]( int code ) {
+      Shape shape = Shape::fromCode( code );
+      if ( !shape.isCanonical() )
+         return;
+      DagPlan plan = search.search( shape.str() );
+      numShapes++;
+      numCheaper += plan.cost < plan.treeCost;
+      numNotExhaustive += !plan.exhaustive;
+      totalTreeCost += plan.treeCost;
+      totalCost += plan.cost;
+      savings[plan.treeCost - plan.cost]++;
+      if ( plan.treeCost - plan.cost > bestSaving )
+      {
+         bestSaving = plan.treeCost - plan.cost;
+         best = shape.str();
+      }
+   } );
+
+   std::trace << "shared intermediates: " << numCheaper << " of " << numShapes << " canonical shapes get cheaper, total cost "
+         << totalTreeCost << " -> " << totalCost << " (" << numNotExhaustive << " searches hit the effort bound)" << std::endl;
+   for ( const auto& saving : savings )
+      std::trace << "saving " << saving.first << ": " << saving.second << " shapes" << std::endl;
+   if ( bestSaving )
+      std::trace << "biggest saving: " << best << " by " << bestSaving << std::endl;
+}
+
+struct MultiTargetReport
+{
+   int numSharedLines = 0;    // lines with more than one use
+   int numProducersSaved = 0; // compared with planning each target on its own
+   int numCuttersSaved = 0;
+   int numStackersSaved = 0;
+   int numRotatorsSaved = 0;
+   int numMachinesSaved() const { return numCuttersSaved + numStackersSaved + numRotatorsSaved; }
+};
+
+// Plans one factory for several targets at their rates: a ThroughputPlanner that merges their recipe trees on their
+// intermediates, so that each distinct colored code is made on one line sized for the demand of all its uses. The
+// report compares its machines with those of each target planned on its own.
+class MultiTargetPlanner : public ThroughputPlanner
+{
+public:
+   MultiTargetPlanner( const Recipes& recipes, const std::vector<TargetRate>& targets, const BuildingSpeeds& speeds = BuildingSpeeds() )
+      : ThroughputPlanner( recipes, targets, speeds, true )
+   {
+      for ( const PlanLine& line : _Lines )
+         _Report.numSharedLines += line.numUses > 1;
+
+      if ( targets.size() > 1 )
+      {
+         int separate[NUM_COUNTS] = {};
+         int combined[NUM_COUNTS] = {};
+         for ( const TargetRate& target : targets )
+            countMachines( ThroughputPlanner( recipes, { target }, speeds, true )._BluePrint, separate );
+         countMachines( _BluePrint, combined );
+         _Report.numProducersSaved = separate[PRODUCERS_COUNT] - combined[PRODUCERS_COUNT];
+         _Report.numCuttersSaved = separate[CUTTERS_COUNT] - combined[CUTTERS_COUNT];
+         _Report.numStackersSaved = separate[STACKERS_COUNT] - combined[STACKERS_COUNT];
+         _Report.numRotatorsSaved = separate[ROTATORS_COUNT] - combined[ROTATORS_COUNT];
+      }
+   }
+
+   std::string str() const
+   {
+      std::stringstream ss;
+      ss << ThroughputPlanner::str();
+      ss << "shared lines = " << _Report.numSharedLines << " producers saved = " << _Report.numProducersSaved
+         << " machines saved = " << _Report.numMachinesSaved() << " (cutters " << _Report.numCuttersSaved
+         << ", stackers " << _Report.numStackersSaved << ", rotators " << _Report.numRotatorsSaved << ")" << std::endl;
+      return ss.str();
+   }
+
+private:
+   enum Count { PRODUCERS_COUNT=0, CUTTERS_COUNT=1, STACKERS_COUNT=2, ROTATORS_COUNT=3, NUM_COUNTS=4 };
+
+   static void countMachines( const BluePrint& bluePrint, int counts[NUM_COUNTS] )
+   {
+      for ( const std::shared_ptr<Building>& building : bluePrint._Buildings )
+      {
+         OpKind kind = NO_OP;
+         for ( int op = RAW; op < NUM_OPS; op++ )
+            if ( opInfo( (Op) op ).building == building->_Type )
+               kind = opInfo( (Op) op ).kind;
+         if ( kind == RAW_OP ) counts[PRODUCERS_COUNT]++;
+         if ( kind == CUT_OP ) counts[CUTTERS_COUNT]++;
+         if ( kind == STACK_OP ) counts[STACKERS_COUNT]++;
+         if ( kind == ROTATE_OP ) counts[ROTATORS_COUNT]++;
+      }
+   }
+
+public:
+   MultiTargetReport _Report;
+};
+
+
+// Partners for the generator's stacking step, grouped so that a shape only meets distinct outcomes.
+// stack( a, b ) puts b at layer offset max(0, max over quadrants q of top(a,q) - bottom(b,q)), where top(a,q) is one
+// above the highest layer of a having q (0 if none) and bottom(b,q) the lowest layer of b having q (4 if none).
+// So the offset depends on b only through b's "bottom profile", and the result only through the 4-offset lowest
+// layers of b (the rest ends up above layer 4). Within each (bottom profile, truncated layers) class only the
+// first partner, which is the cheapest one, is kept.
+//
+// Stacking is a join between cost buckets: once all shapes of a cost are finalized, they are joined against every
+// bucket so far (including their own), cheapest bucket first. Every pair of a bucket pair has the same cost, so a
+// result is only ever improved by an earlier bucket pair; pairs that tie are settled by the generator's bestOrder.
+// The new shapes go through in tiles, so each bucket's partners are read once per tile instead of once per shape.
+class StackingIndex
+{
+public:
+   struct Partner
+   {
+      uint16_t code;
+      uint16_t truncated; // only the layers that can stay below the top
+   };
+   struct Group // partners with the same profile (and number of kept layers)
+   {
+      int profile[4];
+      int numLayers;
+      int begin;
+      int end;
+   };
+   struct Bucket
+   {
+      Bucket( int cost ) : cost( cost ) {}
+
+      int cost;
+      std::vector<uint16_t> shapes; // in the order they were finalized
+      std::vector<Partner> onto;    // class representatives grouped by (bottom profile, kept layers), for stack( new, partner )
+      std::vector<Group> ontoGroups;
+      std::vector<Partner> under;   // all shapes grouped by top profile, for stack( partner, new )
+      std::vector<Group> underGroups;
+   };
+
+   static const int TILE_SIZE = 256;
+
+   // lowest layer that has each quadrant, 4 if none
+   static void bottomProfile( const Shape& shape, int* profile )
+   {
+      for ( int q = 0; q < 4; q++ )
+      {
+         profile[q] = 4;
+         for ( int i = 3; i >= 0; i-- )
+            if ( shape.layers[i].b & (1<<q) )
+               profile[q] = i;
+      }
+   }
+   // one above the highest layer that has each quadrant, 0 if none
+   static void topProfile( const Shape& shape, int* profile )
+   {
+      for ( int q = 0; q < 4; q++ )
+      {
+         profile[q] = 0;
+         for ( int i = 0; i < 4; i++ )
+            if ( shape.layers[i].b & (1<<q) )
+               profile[q] = i+1;
+      }
+   }
+   // same as bLayerOffsetForStacking
+   static int offset( const int* topProfileOfA, const int* bottomProfileOfB )
+   {
+      int ret = 0;
+      for ( int q = 0; q < 4; q++ )
+         ret = std::max( ret, topProfileOfA[q] - bottomProfileOfB[q] );
+      return ret;
+   }
+   static int profileKey( const int* profile ) { return ((profile[3]*5 + profile[2])*5 + profile[1])*5 + profile[0]; }
+
+   // b was just finalized with `cost` (costs never go down)
+   void add( const Shape& b, int cost )
+   {
+      if ( _Buckets.empty() || _Buckets.back().cost != cost )
+         _Buckets.push_back( Bucket( cost ) );
+      _Buckets.back().shapes.push_back( b.code() );
+      _NumPartners++;
+   }
+
+   // f( result code, bottom code, top code, partner cost ) for all pairs of the bucket of `cost` (which must be
+   // complete) with any bucket that costs at most `maxPartnerCost`
+   template<class F> void join( int cost, int maxPartnerCost, F f )
+   {
+      if ( _Buckets.empty() || _Buckets.back().cost != cost )
+         return;
+      groupPartners( _Buckets.back() );
+
+      const std::vector<uint16_t>& shapes = _Buckets.back().shapes;
+      _NumNaivePairs += 2 * (int64_t) shapes.size() * _NumPartners;
+
+      int tops[TILE_SIZE][4];
+      int bottoms[TILE_SIZE][4];
+      for ( int tileBegin = 0; tileBegin < (int) shapes.size(); tileBegin += TILE_SIZE )
+      {
+         int tileSize = std::min( (int) TILE_SIZE, (int) shapes.size() - tileBegin );
+         const uint16_t* tile = &shapes[tileBegin];
+         for ( int i = 0; i < tileSize; i++ )
+         {
+            topProfile( Shape::fromCode( tile[i] ), tops[i] );
+            bottomProfile( Shape::fromCode( tile[i] ), bottoms[i] );
+         }
+
+         for ( const Bucket& bucket : _Buckets )
+         {
+            if ( bucket.cost > maxPartnerCost )
+            {
+               _NumBucketPairsSkipped++;
+               continue;
+            }
+            _NumBucketPairs++;
+
+            for ( const Group& group : bucket.ontoGroups )
+            {
+               for ( int i = 0; i < tileSize; i++ )
+               {
+                  int o = offset( tops[i], group.profile );
+                  if ( 4-o != group.numLayers )
+                     continue;
+                  _NumVisited += group.end - group.begin;
+                  for ( int k = group.begin; k < group.end; k++ )
+                     f( (uint16_t) (tile[i] | (bucket.onto[k].truncated << o*4)), tile[i], bucket.onto[k].code, bucket.cost );
+               }
+            }
+
+            // stack( x, y ) with both in this bucket is already covered above
+            if ( bucket.cost == cost )
+               continue;
+            for ( const Group& group : bucket.underGroups )
+            {
+               _NumVisited += (int64_t) tileSize * (group.end - group.begin);
+               for ( int i = 0; i < tileSize; i++ )
+               {
+                  uint16_t shifted = (uint16_t) (tile[i] << offset( group.profile, bottoms[i] )*4);
+                  for ( int k = group.begin; k < group.end; k++ )
+                     f( (uint16_t) (bucket.under[k].code | shifted), bucket.under[k].code, tile[i], bucket.cost );
+               }
+            }
+         }
+      }
+   }
+
+   void traceStats() const
+   {
+      std::trace << "stacking pairs: naive = " << _NumNaivePairs << " visited = " << _NumVisited << std::endl;
+      std::trace << "stacking partner classes = " << _Classes.size() << " for " << _NumPartners << " partners" << std::endl;
+      std::trace << "stacking bucket pairs (per tile): joined = " << _NumBucketPairs << " skipped = " << _NumBucketPairsSkipped << std::endl;
+   }
+
+private:
+   void groupPartners( Bucket& bucket )
+   {
+      std::vector<std::pair<int, Partner>> onto;
+      std::vector<std::pair<int, Partner>> under;
+      for ( uint16_t code : bucket.shapes )
+      {
+         Shape shape = Shape::fromCode( code );
+         int bottom[4];
+         int top[4];
+         bottomProfile( shape, bottom );
+         topProfile( shape, top );
+         for ( int numLayers = 0; numLayers <= 4; numLayers++ )
+         {
+            uint16_t truncated = (uint16_t) (code & ((1 << numLayers*4) - 1));
+            int key = profileKey( bottom )*5 + numLayers;
+            if ( _Classes.insert( key << 16 | truncated ).second )
+               onto.push_back( { key, { code, truncated } } );
+         }
+         under.push_back( { profileKey( top ), { code, code } } );
+      }
+      makeGroups( onto, bucket.onto, bucket.ontoGroups, true );
+      makeGroups( under, bucket.under, bucket.underGroups, false );
+   }
+
+   static void makeGroups( std::vector<std::pair<int, Partner>>& keyed, std::vector<Partner>& partners, std::vector<Group>& groups, bool keyHasNumLayers )
+   {
+      std::stable_sort( keyed.begin(), keyed.end(), []( const std::pair<int, Partner>& a, const std::pair<int, Partner>& b ) { return a.first < b.first; } );
+      for ( int i = 0; i < (int) keyed.size(); i++ )
+      {
+         if ( i == 0 || keyed[i].first != keyed[i-1].first )
+         {
+            Group group;
+            int profile = keyHasNumLayers ? keyed[i].first / 5 : keyed[i].first;
+            for ( int q = 0; q < 4; q++, profile /= 5 )
+               group.profile[q] = profile % 5;
+            group.numLayers = keyHasNumLayers ? keyed[i].first % 5 : 4;
+            group.begin = i;
+            groups.push_back( group );
+         }
+         groups.back().end = i+1;
+         partners.push_back( keyed[i].second );
+      }
+   }
+
+public:
+   std::vector<Bucket> _Buckets;
+   std::unordered_set<uint32_t> _Classes;
+   int _NumPartners = 0;
+
+   int64_t _NumNaivePairs = 0;
+   int64_t _NumVisited = 0;
+   int64_t _NumBucketPairs = 0;
+   int64_t _NumBucketPairsSkipped = 0;
+};
+
+// for the names of recipe files that aren't made of CLASSIC_OPS
+inline std::string opsSuffix( OpMask ops )
+{
+   if ( ops == CLASSIC_OPS )
+      return "";
+   std::stringstream ss;
+   ss << "_ops" << std::hex << ops;
+   return ss.str();
+}
+
+// with `layoutAware`, recipes that tie on cost are compared on the geometry bluePrintFor would give them (see
+// RecipeMetricsTable::hasBetterLayout), as long as the shape hasn't been expanded yet; `ops` are the ops it may use
+inline Recipes generateRecipes( int rotateCost = 0, int cutCost = 1, int stackCost = 1, bool layoutAware = false, OpMask ops = CLASSIC_OPS )
+{
+   const int ROTATE_COST = rotateCost;
+   const int CUT_COST = cutCost;
+   const int STACK_COST = stackCost;
+   if ( STACK_COST < 1 )
+      throw 777; // stacking is done once a cost is complete, so it must cost something
+
+   std::unordered_set<uint16_t> usedShapesSet = { 0 };
+
+   std::vector<std::pair<Shape, int>> allShapes;
+   std::vector<std::pair<Shape, int>> allCanonicalShapes;
+   std::vector<std::deque<Shape>> q( 1000 );
+
+   std::vector<std::vector<Shape>> shapesWithCost( q.size() );
+   std::vector<std::vector<Shape>> canonicalShapesWithCost( q.size() );
+
+   Recipes recipes;
+   std::vector<int> bestCostForShape( 1<<16, IMPOSSIBLE_COST );
+   std::vector<RecipeMetrics> metrics( layoutAware ? 1<<16 : 0 );
+   StackingIndex stackingIndex;
+
+   // Cost ties go to the recipe that expanding the shapes one by one would find first: in the order the shapes
+   // became final, each one's unary ops (rotations first), then each one stacked with every final shape so far,
+   // both ways. Stacking is joined per bucket, so the order is computed rather than taken from when a recipe shows up.
+   std::vector<int> finalIndex( 1<<16, 0 );
+   std::vector<uint64_t> bestOrder( 1<<16, 0 );
+   auto unaryOrder = [&]( uint16_t a, int rank ) { return (uint64_t) finalIndex[a] << 24 | rank; };
+   auto stackOrder = [&]( uint16_t bottom, uint16_t top ) {
+      int b = finalIndex[bottom], t = finalIndex[top];
+      return (uint64_t) std::max( b, t ) << 24 | 1 << 23 | (uint64_t) std::min( b, t ) << 1 | (b >= t ? 0 : 1);
+   };
+
+   auto addShapeToQ = [&]( const Shape& shape, Op op, int cost, uint16_t codeA, uint16_t codeB, uint64_t order ) {
+      //if ( shape.numLayers() <= 2 )
+      //   cost = 1;
+
+      int code = shape.code();
+      if ( layoutAware && cost == bestCostForShape[code] && !usedShapesSet.count( code ) )
+      {
+         RecipeMetrics m = RecipeMetricsTable::metricsFor( { codeA, codeB, op }, metrics[codeA], metrics[codeB] );
+         if ( RecipeMetricsTable::hasBetterLayout( m, metrics[code] )
+            || (!RecipeMetricsTable::hasBetterLayout( metrics[code], m ) && order < bestOrder[code]) )
+         {
+            metrics[code] = m;
+            recipes[code] = { codeA, codeB, op };
+            bestOrder[code] = order;
+         }
+         return;
+      }
+      if ( cost == bestCostForShape[code] && order < bestOrder[code] )
+      {
+         recipes[code] = { codeA, codeB, op };
+         bestOrder[code] = order;
+         return;
+      }
+
+      if ( cost >= bestCostForShape[code] || cost >= (int) q.size() )
+         return;
+      bestCostForShape[code] = cost;
+      bestOrder[code] = order;
+      recipes[code] = { codeA, codeB, op };
+      if ( layoutAware )
+         metrics[code] = RecipeMetricsTable::metricsFor( { codeA, codeB, op }, metrics[codeA], metrics[codeB] );
+      q[cost].push_back( shape );
+   };
+
+   std::vector<Op> unaryOps;
+   for ( OpKind kind : { ROTATE_OP, CUT_OP } )
+      for ( int op = 0; op < NUM_OPS; op++ )
+         if ( (ops & opBit( (Op) op )) && opInfo( (Op) op ).kind == kind )
+            unaryOps.push_back( (Op) op );
+
+   for ( int i = 1; i <= 1 && (ops & opBit( RAW )); i++ )
+   {
+      addShapeToQ( Shape::fromCode( i ), RAW, 0, 0, 0, 0 );
+   }
+
+   for ( int cost = 0; cost < (int) q.size(); cost++ )
+   {
+      if ( q[cost].empty() )
+         continue;
+
+      std::trace << "cost = " << cost << " allShapes.size() == " << allShapes.size() << std::endl;
+      std::trace << "cost = " << cost << " allCanonicalShapes.size() == " << allCanonicalShapes.size() << std::endl;
+
+      // zero cost ops only append shapes that come after these
+      std::stable_sort( q[cost].begin(), q[cost].end(), [&]( const Shape& a, const Shape& b ) { return bestOrder[a.code()] < bestOrder[b.code()]; } );
+      while ( !q[cost].empty() )
+      {
+         Shape shape = q[cost].front();
+         q[cost].pop_front();
+
+         if ( !usedShapesSet.insert( shape.code() ).second )
+            continue;
+
+         finalIndex[shape.code()] = (int) allShapes.size();
+         allShapes.push_back( { shape, cost } );
+         if ( shape.isCanonical() )
+            allCanonicalShapes.push_back( { shape, cost } );
+         if ( shape.isCanonical() )
+            canonicalShapesWithCost[cost].push_back( shape );
+         shapesWithCost[cost].push_back( shape );
+
+         ////Cu------:--Cu--Cu:Cu--Cu--:--Cu--Cu
+         //if ( shape.code() == 0b1010'0101'1010'0001 )
+         //   trace << recipeFor( shape, "" ) << endl;
+
+         //if ( shape.code() == 0b1111'1111 )
+         //if ( shape.code() == 0b0010'0001 )
+         //if ( shape.code() == 0b1010'0101'1010'0001 )
+         //if ( shape.code() == 0b1001'0110'1100'0011 )
+         //if ( shape.code() == 0b0110'1010'0011'0100 ) // ----Cu--:CuCu----:--Cu--Cu:--CuCu-- (needs 3 cuts)
+         //if ( shape.code() == 0b0101'1010'0101'1000 ) // ------Cu:Cu--Cu--:--Cu--Cu:Cu--Cu--
+         //if ( shape.code() == 0b0001'0001'0011'1000 ) // ------Cu:CuCu----:Cu------:Cu------
+         //if ( shape.code() == targetShapeCode )
+         //{
+         //   trace << recipeFor( shape, "" ) << endl;
+         //   trace << "blueprint for " << shape.str() << endl;
+         //   trace << bluePrintFor( shape, Mapping::identity() ).toJson() << endl;
+
+         //}
+
+
+         if ( allShapes.size() % 1000 == 0 )
+            std::trace << allShapes.size() << std::endl;
+
+
+         for ( int i = 0; i < (int) unaryOps.size(); i++ )
+            addShapeToQ( applyOp( unaryOps[i], shape ), unaryOps[i], cost+opCost( unaryOps[i], ROTATE_COST, CUT_COST, STACK_COST ), shape.code(), 0, unaryOrder( shape.code(), i ) );
+
+         if ( ops & opBit( STACK ) )
+            stackingIndex.add( shape, cost );
+      }
+
+      // everything with this cost is final, stack it with everything so far (see StackingIndex)
+      stackingIndex.join( cost, (int) q.size() - 1 - cost - STACK_COST, [&]( uint16_t result, uint16_t bottom, uint16_t top, int partnerCost ) {
+         addShapeToQ( Shape::fromCode( result ), STACK, cost+partnerCost+STACK_COST, bottom, top, stackOrder( bottom, top ) );
+      } );
+
+      std::trace << "#shapes with cost " << cost << " = " << shapesWithCost[cost].size() << std::endl;
+      std::trace << "#canonical shapes with cost " << cost << " = " << canonicalShapesWithCost[cost].size() << std::endl;
+
+      if ( canonicalShapesWithCost[cost].size() <= 100 )
+         for ( const Shape& shape : canonicalShapesWithCost[cost] )
+            std::trace << shape.str() << std::endl;
+   }
+
+
+   stackingIndex.traceStats();
+   recipes.indexUsers();
+   return recipes;
+}
+
+inline void generateRecipesFile( int rotateCost = 0, int cutCost = 1, int stackCost = 1, bool layoutAware = false, OpMask ops = CLASSIC_OPS )
+{
+   Recipes recipes = generateRecipes( rotateCost, cutCost, stackCost, layoutAware, ops );
+
+   std::string filename = "recipes_" + std::to_string( rotateCost ) + "_" + std::to_string( cutCost ) + "_" + std::to_string( stackCost ) + ( layoutAware ? "_layout" : "" ) + opsSuffix( ops ) + ".bin";
+   recipes.writeToFile( filename );
+   PossibleShapes possibleShapes;
+   possibleShapes._IsPossible = recipes.possibleShapes();
+   possibleShapes.writeToFile( "shape_is_possible" + opsSuffix( ops ) + ".bin" );
+}
+
+// one point of a shape's Pareto front: how many cuts, stacks and rotates its recipe tree needs
+#pragma pack(push, 1)
+struct ParetoLabel
+{
+   uint8_t cuts = 0;
+   uint8_t stacks = 0;
+   uint8_t rotates = 0;
+   Recipe recipe;
+
+   int total() const { return cuts + stacks + rotates; }
+   int cost( int rotateCost, int cutCost, int stackCost ) const { return rotates * rotateCost + cuts * cutCost + stacks * stackCost; }
+   bool dominatesOrEquals( const ParetoLabel& rhs ) const { return cuts <= rhs.cuts && stacks <= rhs.stacks && rotates <= rhs.rotates; }
+};
+#pragma pack(pop)
+
+// Pareto fronts of (cuts, stacks, rotates) for every code; gives the recipes for any cost weighting
+class ParetoRecipes
+{
+public:
+   ParetoRecipes() : _Fronts( 1<<16 ) {}
+   ParetoRecipes( const std::string& filename ) : ParetoRecipes()
+   {
+      loadFromFile( filename );
+   }
+
+   const std::vector<ParetoLabel>& operator[]( int code ) const { return _Fronts[code]; }
+   std::vector<ParetoLabel>& operator[]( int code ) { return _Fronts[code]; }
+
+   // nullptr if there is no recipe. Ties go to the label with fewer operations, which keeps the
+   // recipes chosen for a weighting acyclic even when some operation is free.
+   const ParetoLabel* best( int code, int rotateCost, int cutCost, int stackCost ) const
+   {
+      const ParetoLabel* ret = nullptr;
+      for ( const ParetoLabel& label : _Fronts[code] )
+      {
+         if ( !ret 
+            || label.cost( rotateCost, cutCost, stackCost ) < ret->cost( rotateCost, cutCost, stackCost )
+            || (label.cost( rotateCost, cutCost, stackCost ) == ret->cost( rotateCost, cutCost, stackCost ) && label.total() < ret->total()) )
+            ret = &label;
+      }
+      return ret;
+   }
+
+   Recipes recipesFor( int rotateCost, int cutCost, int stackCost ) const
+   {
+      Recipes ret;
+      for ( int code = 1; code < (int) _Fronts.size(); code++ )
+         if ( const ParetoLabel* label = best( code, rotateCost, cutCost, stackCost ) )
+            ret[code] = label->recipe;
+      ret.indexUsers();
+      return ret;
+   }
+
+   int numLabels() const { int ret = 0; for ( const std::vector<ParetoLabel>& front : _Fronts ) ret += (int) front.size(); return ret; }
+
+   // front sizes (uint16_t per code), followed by all labels in code order
+   void writeToFile( const std::string& filename ) const
+   {
+      std::vector<uint16_t> sizes;
+      std::vector<ParetoLabel> labels;
+      for ( const std::vector<ParetoLabel>& front : _Fronts )
+      {
+         sizes.push_back( (uint16_t) front.size() );
+         labels.insert( labels.end(), front.begin(), front.end() );
+      }
+      std::ofstream f( filename, std::ios::binary );
+      f.write( (const char*) sizes.data(), sizes.size()*sizeof(uint16_t) );
+      f.write( (const char*) labels.data(), labels.size()*sizeof(ParetoLabel) );
+      std::trace << "wrote pareto recipes here: " << filename << std::endl;
+   }
+   bool loadFromFile( const std::string& filename )
+   {
+      std::ifstream f( filename, std::ios::binary );
+      std::vector<uint16_t> sizes( _Fronts.size() );
+      f.read( (char*) sizes.data(), sizes.size()*sizeof(uint16_t) );
+      for ( int code = 0; code < (int) _Fronts.size() && f.good(); code++ )
+      {
+         _Fronts[code].resize( sizes[code] );
+         f.read( (char*) _Fronts[code].data(), sizes[code]*sizeof(ParetoLabel) );
+      }
+      return f.good();
+   }
+
+public:
+   std::vector<std::vector<ParetoLabel>> _Fronts;
+};
+
+// Generates the Pareto fronts of all cost weightings in one pass (instead of one generateRecipesFile() run per weighting).
+// Labels are finalized in order of their number of operations; a label can only be dominated by one with fewer operations,
+// so each label that is not dominated when it is popped stays on the front.
+inline void generateParetoRecipesFile( bool singleLayerIsRaw, OpMask ops = CLASSIC_OPS )
+{
+   struct Pending
+   {
+      uint16_t code;
+      ParetoLabel label;
+   };
+
+   ParetoRecipes pareto;
+   ParetoRecipes tentative; // labels in the queue that nothing dominates (yet)
+   std::vector<Pending> finalized;
+   std::vector<std::deque<Pending>> q( 1000 );
+
+   auto isDominated = [&]( uint16_t code, const ParetoLabel& label ) {
+      for ( const ParetoLabel& other : pareto[code] )
+         if ( other.dominatesOrEquals( label ) )
+            return true;
+      for ( const ParetoLabel& other : tentative[code] )
+         if ( other.dominatesOrEquals( label ) )
+            return true;
+      return false;
+   };
+
+   auto addLabelToQ = [&]( const Shape& shape, Op op, int cuts, int stacks, int rotates, uint16_t codeA, uint16_t codeB ) {
+      if ( shape.code() == 0 || cuts > 255 || stacks > 255 || rotates > 255 )
+         return;
+      Pending p;
+      p.code = shape.code();
+      p.label.cuts = (uint8_t) cuts;
+      p.label.stacks = (uint8_t) stacks;
+      p.label.rotates = (uint8_t) rotates;
+      p.label.recipe = { codeA, codeB, op };
+      if ( isDominated( p.code, p.label ) )
+         return;
+      std::vector<ParetoLabel>& t = tentative[p.code];
+      t.erase( std::remove_if( t.begin(), t.end(), [&]( const ParetoLabel& other ) { return p.label.dominatesOrEquals( other ); } ), t.end() );
+      t.push_back( p.label );
+      q[p.label.total()].push_back( p );
+   };
+
+   for ( int i = 1; i <= (singleLayerIsRaw ? 15 : 1) && (ops & opBit( RAW )); i++ )
+      addLabelToQ( Shape::fromCode( i ), RAW, 0, 0, 0, 0, 0 );
+
+   for ( int total = 0; total < (int) q.size(); total++ )
+   {
+      if ( q[total].empty() )
+         continue;
+
+      while ( !q[total].empty() )
+      {
+         Pending p = q[total].front();
+         q[total].pop_front();
+
+         // skip labels that a better one replaced while they were queued
+         std::vector<ParetoLabel>& t = tentative[p.code];
+         auto it = std::find_if( t.begin(), t.end(), [&]( const ParetoLabel& other ) { return memcmp( &other, &p.label, sizeof(ParetoLabel) ) == 0; } );
+         if ( it == t.end() )
+            continue;
+         t.erase( it );
+
+         pareto[p.code].push_back( p.label );
+         finalized.push_back( p );
+
+         Shape shape = Shape::fromCode( p.code );
+         const ParetoLabel& l = p.label;
+
+         for ( int op = 0; op < NUM_OPS; op++ )
+         {
+            OpKind kind = opInfo( (Op) op ).kind;
+            if ( (ops & opBit( (Op) op )) && (kind == CUT_OP || kind == ROTATE_OP) )
+               addLabelToQ( applyOp( (Op) op, shape ), (Op) op, l.cuts + (kind == CUT_OP), l.stacks, l.rotates + (kind == ROTATE_OP), p.code, 0 );
+         }
+
+         for ( const Pending& b : finalized )
+         {
+            if ( !(ops & opBit( STACK )) )
+               break;
+            Shape bShape = Shape::fromCode( b.code );
+            int cuts = l.cuts + b.label.cuts;
+            int stacks = l.stacks + b.label.stacks + 1;
+            int rotates = l.rotates + b.label.rotates;
+            addLabelToQ( ::stack( shape, bShape ), STACK, cuts, stacks, rotates, p.code, b.code );
+            addLabelToQ( ::stack( bShape, shape ), STACK, cuts, stacks, rotates, b.code, p.code );
+         }
+      }
+
+      std::trace << "#operations = " << total << " #labels = " << finalized.size() << std::endl;
+   }
+
+   pareto.writeToFile( std::string( singleLayerIsRaw ? "recipes_paretor" : "recipes_pareto" ) + opsSuffix( ops ) + ".bin" );
+}
+
+// Precomputed blueprints of every possible code of some recipe tables, served without laying anything out.
+//
+// One blueprint is kept per rotation class, for its smallest code; the other rotations get one rotator on top of it,
+// so for them the atlas serves a building more than Recipes::bluePrintFor lays out, and its factory in the next row.
+// A blueprint is kept with its colors left open: each quadrant of a constant signal holds the index of the target's
+// quadrant that codeForShape takes its color from, so serving a target only fills in the target's colors. Records are
+// packed, per building a byte of type and rotation and its position as zigzag varints relative to the previous
+// building's, and records that come out the same for several tables are stored once.
+//
+// File: "SHZATLS1", uint32 number of tables, per table the uint32 length of its recipe filename and the name, per table
+// 65536 uint32 record offsets (NO_RECORD for codes that aren't kept), then the records. It is mapped into memory and
+// records are read where they lie; loading checks that every record the index points to lies within the file.
+class BluePrintAtlas
+{
+public:
+   static const uint32_t NO_RECORD = 0xFFFFFFFF;
+   static const uint8_t EMPTY_LABEL = 0xFF;
+   static const uint8_t UNCOLORED_LABEL = 0xFE;
+
+   BluePrintAtlas() {}
+   BluePrintAtlas( const std::string& filename )
+   {
+      loadFromFile( filename );
+   }
+
+   // the code a blueprint of `code` is kept under, and the quarter turns clockwise that make `code` from it
+   static uint16_t keptCodeFor( uint16_t code, int& numRotations )
+   {
+      uint16_t ret = code;
+      numRotations = 0;
+      Shape shape = Shape::fromCode( code );
+      for ( int k = 1; k < 4; k++ )
+      {
+         shape = shape.rotated();
+         if ( shape.code() < ret )
+         {
+            ret = shape.code();
+            numRotations = 4 - k;
+         }
+      }
+      return ret;
+   }
+
+   // blueprints of every possible code of each recipe file, laid out on `numThreads` threads
+   static void writeToFile( const std::string& filename, const std::vector<std::string>& recipesFilenames, int numThreads = 0 )
+   {
+      struct Job
+      {
+         int table;
+         uint16_t code;
+      };
+
+      std::vector<Recipes> tables;
+      std::vector<Job> jobs;
+      for ( int table = 0; table < (int) recipesFilenames.size(); table++ )
+      {
+         tables.push_back( Recipes( recipesFilenames[table] ) );
+         const Recipes& recipes = tables.back();
+         recipes.possibleShapes().forEach( [&]( int code ) {
+            int numRotations;
+            uint16_t kept = keptCodeFor( (uint16_t) code, numRotations );
+            if ( kept == code || !recipes.isPossible( kept ) ) // (tables made without rotators)
+               jobs.push_back( { table, (uint16_t) code } );
+         } );
+      }
+
+      // a finalTarget whose quadrant i has the color "#" + 'a'+i, so codeForShape writes down where each color comes from
+      std::string labelTarget;
+      for ( int i = 0; i < 16; i++ )
+         labelTarget += std::string( i && i % 4 == 0 ? ":" : "" ) + "#" + char( 'a' + i );
+
+      std::vector<std::string> records( jobs.size() );
+      std::atomic<size_t> next( 0 );
+      auto layOut = [&]() {
+         for ( size_t i = next++; i < jobs.size(); i = next++ )
+            records[i] = recordFor( tables[jobs[i].table].bluePrintFor( Shape::fromCode( jobs[i].code ), labelTarget, Mapping::identity() ) );
+      };
+      if ( numThreads <= 0 )
+         numThreads = std::max( (int) std::thread::hardware_concurrency(), 1 );
+      std::vector<std::thread> threads;
+      for ( int i = 0; i < numThreads; i++ )
+         threads.push_back( std::thread( layOut ) );
+      for ( std::thread& thread : threads )
+         thread.join();
+
+      std::vector<uint32_t> index( recipesFilenames.size() << 16, (uint32_t) NO_RECORD );
+      std::unordered_map<std::string, uint32_t> offsets;
+      std::string data;
+      for ( size_t i = 0; i < jobs.size(); i++ )
+      {
+         auto it = offsets.find( records[i] );
+         if ( it == offsets.end() )
+         {
+            it = offsets.insert( { records[i], (uint32_t) data.size() } ).first;
+            data += records[i];
+         }
+         index[(jobs[i].table << 16) + jobs[i].code] = it->second;
+      }
+
+      std::ofstream f( filename, std::ios::binary );
+      f.write( "SHZATLS1", 8 );
+      uint32_t numTables = (uint32_t) recipesFilenames.size();
+      f.write( (const char*) &numTables, sizeof(numTables) );
+      for ( const std::string& name : recipesFilenames )
+      {
+         uint32_t length = (uint32_t) name.size();
+         f.write( (const char*) &length, sizeof(length) );
+         f.write( name.data(), length );
+      }
+      f.write( (const char*) index.data(), index.size()*sizeof(uint32_t) );
+      f.write( data.data(), data.size() );
+      std::trace << "blueprint atlas: " << jobs.size() << " blueprints, " << offsets.size() << " distinct, " << data.size() << " bytes of records" << std::endl;
+      std::trace << "wrote blueprint atlas here: " << filename << std::endl;
+   }
+
+   bool loadFromFile( const std::string& filename )
+   {
+      _Tables.clear();
+      if ( !_File.open( filename ) || !isValid() )
+      {
+         _File.close();
+         _Tables.clear();
+         return false;
+      }
+      return true;
+   }
+
+   // -1 if the atlas wasn't made from that recipe file
+   int tableFor( const std::string& recipesFilename ) const
+   {
+      auto it = std::find( _Tables.begin(), _Tables.end(), recipesFilename );
+      return it == _Tables.end() ? -1 : (int) (it - _Tables.begin());
+   }
+
+   // the packed blueprint `code` is made from (see keptCodeFor), in the loaded file; nullptr if the table can't make it
+   const uint8_t* recordFor( int table, uint16_t code, int& numRotations ) const
+   {
+      numRotations = 0;
+      if ( table < 0 || table >= (int) _Tables.size() || code == 0 )
+         return nullptr;
+      uint32_t offset = read32( _IndexPos + ((table << 16) + code)*sizeof(uint32_t) );
+      if ( offset == NO_RECORD )
+         offset = read32( _IndexPos + ((table << 16) + keptCodeFor( code, numRotations ))*sizeof(uint32_t) );
+      return offset == NO_RECORD ? nullptr : _File._Data + _RecordsPos + offset;
+   }
+
+   bool contains( int table, const std::string& finalTarget ) const
+   {
+      int numRotations;
+      return recordFor( table, shapeFromCode( finalTarget ).code(), numRotations ) != nullptr;
+   }
+
+   // appends what BluePrint::toJson gives for the blueprint of `finalTarget`; false if the table can't make it
+   bool appendJson( int table, const std::string& finalTarget, std::string& json ) const
+   {
+      int numRotations;
+      const uint8_t* record = recordFor( table, shapeFromCode( finalTarget ).code(), numRotations );
+      if ( !record )
+         return false;
+      bool first = true;
+      json += "[\n";
+      forEachBuilding( record, finalTarget, numRotations, [&]( BuildingType type, XY pos, int rotation, const std::string* code ) {
+         if ( !first )
+            json += ",";
+         appendBuildingJson( json, type, pos, rotation, code ? constantSignalJson( *code ) : "" );
+         json += "\n";
+         first = false;
+      } );
+      json += "]\n";
+      return true;
+   }
+
+   // empty if the table can't make `finalTarget`
+   BluePrint bluePrintFor( int table, const std::string& finalTarget ) const
+   {
+      BluePrint ret;
+      int numRotations;
+      const uint8_t* record = recordFor( table, shapeFromCode( finalTarget ).code(), numRotations );
+      if ( record )
+         forEachBuilding( record, finalTarget, numRotations, [&]( BuildingType type, XY pos, int rotation, const std::string* code ) {
+            if ( code )
+               ret.add( std::shared_ptr<Building>( new ConstantShapeSignal( shapeFromCode( *code ), *code, pos, rotation ) ) );
+            else
+               ret.add( std::shared_ptr<Building>( new Building( type, pos, rotation ) ) );
+         } );
+      return ret;
+   }
+
+private:
+   static std::string recordFor( const BluePrint& bluePrint )
+   {
+      std::string ret;
+      putVarint( ret, (uint32_t) bluePrint._Buildings.size() );
+      XY last( 0, 0 );
+      for ( const std::shared_ptr<Building>& building : bluePrint._Buildings )
+      {
+         if ( building->_Type >= 64 )
+            throw 777;
+         ret += (char) ((building->_Type << 2) | building->_Rotation);
+         putVarint( ret, zigzag( building->_Pos.x - last.x ) );
+         putVarint( ret, zigzag( building->_Pos.y - last.y ) );
+         last = building->_Pos;
+         if ( building->_Type == CONSTANT_SIGNAL )
+         {
+            const std::string& code = static_cast<const ConstantShapeSignal&>( *building )._Code;
+            int numLayers = (int) (code.size() + 1) / 9;
+            ret += (char) numLayers;
+            for ( int i = 0; i < numLayers*4; i++ )
+            {
+               std::string quadrant = code.substr( (i/4)*9 + (i%4)*2, 2 );
+               ret += quadrant == "--" ? (char) EMPTY_LABEL : quadrant == "Cu" ? (char) UNCOLORED_LABEL : (char) (quadrant[1] - 'a');
+            }
+         }
+      }
+      return ret;
+   }
+
+   // calls f( type, pos, rotation, code ) for each building of `record` made into the blueprint of `finalTarget`,
+   // `code` being the signal's shape code for constant signals and nullptr otherwise
+   template <class F> static void forEachBuilding( const uint8_t* record, const std::string& finalTarget, int numRotations, F f )
+   {
+      XY offset( 0, 0 );
+      if ( numRotations )
+      {
+         f( opInfo( (Op) (ROTATE_1 + numRotations - 1) ).building, XY(0,0), 0, nullptr );
+         offset = XY(0,1);
+      }
+
+      const uint8_t* p = record;
+      std::string code;
+      XY pos( 0, 0 );
+      for ( uint32_t n = getVarint( p ), i = 0; i < n; i++ )
+      {
+         BuildingType type = (BuildingType) (*p >> 2);
+         int rotation = *p++ & 3;
+         pos.x += unzigzag( getVarint( p ) );
+         pos.y += unzigzag( getVarint( p ) );
+         if ( type != CONSTANT_SIGNAL )
+         {
+            f( type, pos + offset, rotation, nullptr );
+            continue;
+         }
+         code.clear();
+         for ( int j = 0, numLayers = *p++; j < numLayers*4; j++ )
+         {
+            if ( j && j % 4 == 0 )
+               code += ":";
+            uint8_t label = *p++;
+            int idx = (label & 12) | ((label + numRotations) & 3); // where the rotator puts that quadrant
+            code += label == EMPTY_LABEL ? "--" : label == UNCOLORED_LABEL ? "Cu" : finalTarget.substr( idx*2 + idx/4, 2 );
+         }
+         f( type, pos + offset, rotation, &code );
+      }
+   }
+
+   static uint32_t zigzag( int x ) { return ((uint32_t) x << 1) ^ (uint32_t) (x >> 31); }
+   static int unzigzag( uint32_t x ) { return (int) (x >> 1) ^ -(int) (x & 1); }
+   static void putVarint( std::string& s, uint32_t x )
+   {
+      for ( ; x >= 128; x >>= 7 )
+         s += (char) (x | 128);
+      s += (char) x;
+   }
+   static uint32_t getVarint( const uint8_t*& p )
+   {
+      uint32_t ret = 0;
+      for ( int shift = 0; ; shift += 7 )
+      {
+         ret |= (uint32_t) (*p & 127) << shift;
+         if ( !(*p++ & 128) )
+            return ret;
+      }
+   }
+   // getVarint for records that haven't been checked yet: false if it runs past `end`
+   static bool getVarint( const uint8_t*& p, const uint8_t* end, uint32_t& x )
+   {
+      x = 0;
+      for ( int shift = 0; p < end && shift < 32; shift += 7 )
+      {
+         x |= (uint32_t) (*p & 127) << shift;
+         if ( !(*p++ & 128) )
+            return true;
+      }
+      return false;
+   }
+   uint32_t read32( size_t pos ) const
+   {
+      uint32_t ret;
+      memcpy( &ret, _File._Data + pos, sizeof(ret) );
+      return ret;
+   }
+
+   // reads the header and checks that the index and the records it points to lie within the file, and that each
+   // record only takes colors from quadrants its code has
+   bool isValid()
+   {
+      size_t size = _File._Size;
+      if ( size < 12 || memcmp( _File._Data, "SHZATLS1", 8 ) != 0 )
+         return false;
+      size_t pos = 12;
+      for ( uint32_t i = 0, n = read32( 8 ); i < n; i++ )
+      {
+         if ( pos + 4 > size || read32( pos ) > size - pos - 4 )
+            return false;
+         _Tables.push_back( std::string( (const char*) _File._Data + pos + 4, read32( pos ) ) );
+         pos += 4 + _Tables.back().size();
+      }
+      _IndexPos = pos;
+      if ( _Tables.size() > (size - pos) / sizeof(uint32_t) >> 16 )
+         return false;
+      _RecordsPos = pos + (_Tables.size() << 16)*sizeof(uint32_t);
+
+      std::unordered_map<uint32_t, int> labelsAt; // record offset => labelsOf it
+      for ( size_t i = 0; i < _Tables.size() << 16; i++ )
+      {
+         uint32_t offset = read32( _IndexPos + i*sizeof(uint32_t) );
+         if ( offset == NO_RECORD )
+            continue;
+         auto it = labelsAt.find( offset );
+         if ( it == labelsAt.end() )
+            it = labelsAt.insert( { offset, labelsOf( offset ) } ).first;
+         if ( it->second < 0 || (it->second & ~(int) (i & 0xFFFF)) )
+            return false;
+      }
+      return true;
+   }
+
+   // the quadrants the signals of the record at `offset` take their colors from, -1 if it runs past the end of the file
+   int labelsOf( uint32_t offset ) const
+   {
+      if ( offset >= _File._Size - _RecordsPos )
+         return -1;
+      const uint8_t* p = _File._Data + _RecordsPos + offset;
+      const uint8_t* end = _File._Data + _File._Size;
+      uint32_t n, x, y;
+      if ( !getVarint( p, end, n ) )
+         return -1;
+      int ret = 0;
+      for ( uint32_t i = 0; i < n; i++ )
+      {
+         if ( p == end )
+            return -1;
+         BuildingType type = (BuildingType) (*p++ >> 2);
+         if ( !getVarint( p, end, x ) || !getVarint( p, end, y ) )
+            return -1;
+         if ( type != CONSTANT_SIGNAL )
+            continue;
+         if ( p == end || *p < 1 || *p > 4 || end - p < 1 + *p*4 )
+            return -1;
+         for ( int j = 0, numLayers = *p++; j < numLayers*4; j++ )
+         {
+            uint8_t label = *p++;
+            if ( label < 16 )
+               ret |= 1 << label;
+            else if ( label != EMPTY_LABEL && label != UNCOLORED_LABEL )
+               return -1;
+         }
+      }
+      return ret;
+   }
+
+public:
+   MappedFile _File;
+   std::vector<std::string> _Tables;
+   size_t _IndexPos = 0;
+   size_t _RecordsPos = 0;
+};
@@ -1,6 +1,21 @@
 #include "trace.h"
 #include <string>
+#ifdef _WIN32
 #include <Windows.h>
+#endif
+
+namespace
+{
+   TraceCallback traceCallback = nullptr;
+   void* traceContext = nullptr;
+   thread_local std::string traceLine; // so threads that trace at once don't interleave within a line
+}
+
+void setTraceCallback( TraceCallback callback, void* context )
+{
+   traceContext = context;
+   traceCallback = callback;
+}
 
 namespace std
 {
@@ -10,17 +25,25 @@ namespace std
       trace_streambuf() {}
       int_type overflow( int_type x )
       {
+         string& buffer = traceLine;
          buffer += (char)x;
          if ( x == 10 )
          {
-            cout << buffer;
-            ::OutputDebugStringA( buffer.c_str() );
+            if ( traceCallback )
+               traceCallback( buffer.c_str(), traceContext );
+#ifndef SHAPEZ_SOLVER_EXPORTS
+            else
+            {
+               cout << buffer;
+#ifdef _WIN32
+               ::OutputDebugStringA( buffer.c_str() );
+#endif
+            }
+#endif
             buffer.clear();
          }
          return 0;
       }
-   private:
-      string buffer;
    };
    std::trace_streambuf trace_buf;
    std::basic_ostream<char, std::char_traits<char>> trace( &trace_buf );
@@ -5,4 +5,9 @@
 namespace std
 {
    extern std::basic_ostream<char, std::char_traits<char>> trace;
-}
\ No newline at end of file
+}
+
+// whole trace lines (ending in '\n') go to `callback` when one is set, from whichever thread traced them;
+// otherwise the solver prints them, and the library (SHAPEZ_SOLVER_EXPORTS) drops them
+typedef void (*TraceCallback)( const char* line, void* context );
+void setTraceCallback( TraceCallback callback, void* context );
\ No newline at end of file